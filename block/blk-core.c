@@ -1052,6 +1052,74 @@ static inline void add_request(struct request_queue *q, struct request *req)
 	__elv_add_request(q, req, ELEVATOR_INSERT_SORT, 0);
 }
 
+/*
+ * A sync write (fsync writeback, O_SYNC, journal commit) has somebody
+ * waiting on it.  Letting it sit behind background writeback in the
+ * elevator only adds latency, so hand it straight to the dispatch list.
+ * Adding at the tail keeps it ordered behind any barrier sequence already
+ * in flight, and the soft barrier keeps elv_dispatch_sort() from putting
+ * sorted requests ahead of it.  Plugged sync writes are usually followed
+ * by the next piece of the same write, which blk_boost_merge() can still
+ * back merge.
+ *
+ * This is off by default and only done for elevators that allow it, the
+ * others order sync writes themselves.  Background requests always go
+ * through the elevator, to be served after the foreground ones.
+ */
+static inline bool blk_boost_sync_write(struct request_queue *q,
+					struct request *req)
+{
+	if (!q->sync_write_boost || !q->elevator ||
+	    !q->elevator->elevator_type->sync_write_boost)
+		return false;
+	if (!blk_fs_request(req) || rq_data_dir(req) != WRITE ||
+	    !rq_is_sync(req) || rq_is_background(req))
+		return false;
+	if (req->cmd_flags & (REQ_HARDBARRIER | REQ_DISCARD))
+		return false;
+	if (test_bit(QUEUE_FLAG_ELVSWITCH, &q->queue_flags))
+		return false;
+
+	drive_stat_acct(req, 1);
+	trace_block_rq_insert(q, req);
+	req->cmd_flags |= REQ_SOFTBARRIER;
+	list_add_tail(&req->queuelist, &q->queue_head);
+	q->boost_last = req;
+	q->nr_boosted++;
+	return true;
+}
+
+/*
+ * Find the boosted request @bio can be back merged into.  It has to be
+ * the last one on the dispatch list, so it is known to still be around,
+ * and not yet seen by the driver, so it can still grow.  Its soft barrier
+ * makes rq_mergeable() and elv_rq_merge_ok() refuse it, so the checks
+ * that matter here are done by hand.
+ */
+static struct request *blk_boost_merge(struct request_queue *q,
+				       struct bio *bio)
+{
+	struct request *req = q->boost_last;
+
+	if (!req || list_empty(&q->queue_head) ||
+	    req != list_entry_rq(q->queue_head.prev))
+		return NULL;
+	if (blk_sorted_rq(req) ||
+	    (req->cmd_flags & (REQ_NOMERGE | REQ_STARTED | REQ_HARDBARRIER)))
+		return NULL;
+	if (blk_rq_pos(req) + blk_rq_sectors(req) != bio->bi_sector)
+		return NULL;
+	if (bio_data_dir(bio) != WRITE ||
+	    bio_rw_flagged(bio, BIO_RW_DISCARD) ||
+	    IOPRIO_PRIO_CLASS(bio_prio(bio)) == IOPRIO_CLASS_IDLE ||
+	    req->rq_disk != bio->bi_bdev->bd_disk || req->special ||
+	    bio_integrity(bio) != blk_integrity_rq(req))
+		return NULL;
+	if (!ll_back_merge_fn(q, req, bio))
+		return NULL;
+	return req;
+}
+
 static void part_round_stats_single(int cpu, struct hd_struct *part,
 				    unsigned long now)
 {
@@ -1175,15 +1243,38 @@ static inline bool queue_should_plug(struct request_queue *q)
 	return !(blk_queue_nonrot(q) && blk_queue_tagged(q));
 }
 
+/*
+ * A bio without a priority of its own inherits one from the submitter:
+ * the io_context priority if one was set with ioprio_set(), otherwise
+ * the idle class if the cpu scheduler considers the task background
+ * (e.g. it sits in a low-share cpu cgroup). Writeback is submitted by
+ * the flusher threads and thus stays in the foreground.
+ */
+static unsigned short blk_bio_ioprio(struct bio *bio)
+{
+	struct io_context *ioc = current->io_context;
+
+	if (bio_prio_valid(bio))
+		return bio_prio(bio);
+
+	if (ioc && ioprio_valid(ioc->ioprio))
+		bio_set_prio(bio, ioc->ioprio);
+	else if (task_sched_background(current))
+		bio_set_prio(bio, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+	return bio_prio(bio);
+}
+
 static int __make_request(struct request_queue *q, struct bio *bio)
 {
 	struct request *req;
 	int el_ret;
 	unsigned int bytes = bio->bi_size;
-	const unsigned short prio = bio_prio(bio);
+	const unsigned short prio = blk_bio_ioprio(bio);
 	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
 	const bool unplug = bio_rw_flagged(bio, BIO_RW_UNPLUG);
 	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+	bool boosted;
 	int rw_flags;
 
 	if (bio_rw_flagged(bio, BIO_RW_BARRIER) &&
@@ -1200,15 +1291,28 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 
 	spin_lock_irq(q->queue_lock);
 
-	if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER)) || elv_queue_empty(q))
+	if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER)))
 		goto get_rq;
 
-	el_ret = elv_merge(q, &req, bio);
+	/*
+	 * A boosted request is no longer known to the elevator, so the
+	 * elevator must not be told about the merge.
+	 */
+	req = NULL;
+	if (sync && bio_data_dir(bio) == WRITE)
+		req = blk_boost_merge(q, bio);
+	boosted = req != NULL;
+	if (boosted)
+		el_ret = ELEVATOR_BACK_MERGE;
+	else if (elv_queue_empty(q))
+		goto get_rq;
+	else
+		el_ret = elv_merge(q, &req, bio);
 	switch (el_ret) {
 	case ELEVATOR_BACK_MERGE:
-		BUG_ON(!rq_mergeable(req));
+		BUG_ON(!boosted && !rq_mergeable(req));
 
-		if (!ll_back_merge_fn(q, req, bio))
+		if (!boosted && !ll_back_merge_fn(q, req, bio))
 			break;
 
 		trace_block_bio_backmerge(q, bio);
@@ -1223,6 +1327,8 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 		if (!blk_rq_cpu_valid(req))
 			req->cpu = bio->bi_comp_cpu;
 		drive_stat_acct(req, 0);
+		if (boosted)
+			goto out;
 		elv_bio_merged(q, req, bio);
 		if (!attempt_back_merge(q, req))
 			elv_merged_request(q, req, el_ret);
@@ -1297,7 +1403,8 @@ get_rq:
 		req->cpu = blk_cpu_to_group(smp_processor_id());
 	if (queue_should_plug(q) && elv_queue_empty(q))
 		blk_plug_device(q);
-	add_request(q, req);
+	if (!blk_boost_sync_write(q, req))
+		add_request(q, req);
 out:
 	if (unplug || !queue_should_plug(q))
 		__generic_unplug_device(q);
@@ -1744,8 +1851,38 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+#ifdef CONFIG_BLK_WRITE_LATENCY
+static void blk_account_write_latency(struct request *req)
+{
+	struct blk_write_stats *ws;
+	u64 now, total;
+
+	if (!blk_fs_request(req) || rq_data_dir(req) != WRITE ||
+	    req == &req->q->bar_rq)
+		return;
+
+	now = sched_clock();
+	if (time_after64(rq_start_time_ns(req), now))
+		return;
+
+	ws = &req->q->write_stats[rq_is_sync(req)];
+	total = now - rq_start_time_ns(req);
+	ws->count++;
+	ws->total_ns += total;
+	if (total > ws->max_ns)
+		ws->max_ns = total;
+	if (rq_io_start_time_ns(req) &&
+	    !time_after64(rq_io_start_time_ns(req), now))
+		ws->service_ns += now - rq_io_start_time_ns(req);
+}
+#else
+static inline void blk_account_write_latency(struct request *req) {}
+#endif
+
 static void blk_account_io_done(struct request *req)
 {
+	blk_account_write_latency(req);
+
 	/*
 	 * Account IO completion.  bar_rq isn't accounted as a normal
 	 * IO on queueing nor completion.  Accounting the containing
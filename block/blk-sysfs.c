@@ -271,6 +271,87 @@ static ssize_t queue_iostats_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+static ssize_t queue_sync_write_boost_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->sync_write_boost, page);
+}
+
+static ssize_t queue_sync_write_boost_store(struct request_queue *q,
+					    const char *page, size_t count)
+{
+	unsigned long boost;
+	ssize_t ret = queue_var_store(&boost, page, count);
+
+	spin_lock_irq(q->queue_lock);
+	q->sync_write_boost = !!boost;
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_sync_write_boosted_show(struct request_queue *q,
+					     char *page)
+{
+	return queue_var_show(q->nr_boosted, page);
+}
+
+#ifdef CONFIG_BLK_WRITE_LATENCY
+static ssize_t queue_write_stats_show(struct request_queue *q, char *page,
+				      int sync)
+{
+	struct blk_write_stats ws;
+
+	spin_lock_irq(q->queue_lock);
+	ws = q->write_stats[sync];
+	spin_unlock_irq(q->queue_lock);
+
+	if (ws.count) {
+		do_div(ws.total_ns, ws.count);
+		do_div(ws.service_ns, ws.count);
+	}
+
+	/* count, then average total, average service and max time in usecs */
+	return sprintf(page, "%lu %llu %llu %llu\n", ws.count,
+		       (unsigned long long)div_u64(ws.total_ns, NSEC_PER_USEC),
+		       (unsigned long long)div_u64(ws.service_ns, NSEC_PER_USEC),
+		       (unsigned long long)div_u64(ws.max_ns, NSEC_PER_USEC));
+}
+
+static ssize_t queue_write_stats_store(struct request_queue *q,
+				       const char *page, size_t count, int sync)
+{
+	spin_lock_irq(q->queue_lock);
+	memset(&q->write_stats[sync], 0, sizeof(q->write_stats[sync]));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+static ssize_t queue_sync_write_stats_show(struct request_queue *q,
+					   char *page)
+{
+	return queue_write_stats_show(q, page, 1);
+}
+
+static ssize_t queue_sync_write_stats_store(struct request_queue *q,
+					    const char *page, size_t count)
+{
+	return queue_write_stats_store(q, page, count, 1);
+}
+
+static ssize_t queue_async_write_stats_show(struct request_queue *q,
+					    char *page)
+{
+	return queue_write_stats_show(q, page, 0);
+}
+
+static ssize_t queue_async_write_stats_store(struct request_queue *q,
+					     const char *page, size_t count)
+{
+	return queue_write_stats_store(q, page, count, 0);
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -374,6 +455,31 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+static struct queue_sysfs_entry queue_sync_write_boost_entry = {
+	.attr = {.name = "sync_write_boost", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_sync_write_boost_show,
+	.store = queue_sync_write_boost_store,
+};
+
+static struct queue_sysfs_entry queue_sync_write_boosted_entry = {
+	.attr = {.name = "sync_write_boosted", .mode = S_IRUGO },
+	.show = queue_sync_write_boosted_show,
+};
+
+#ifdef CONFIG_BLK_WRITE_LATENCY
+static struct queue_sysfs_entry queue_sync_write_stats_entry = {
+	.attr = {.name = "sync_write_stats", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_sync_write_stats_show,
+	.store = queue_sync_write_stats_store,
+};
+
+static struct queue_sysfs_entry queue_async_write_stats_entry = {
+	.attr = {.name = "async_write_stats", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_async_write_stats_show,
+	.store = queue_async_write_stats_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +500,12 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+	&queue_sync_write_boost_entry.attr,
+	&queue_sync_write_boosted_entry.attr,
+#ifdef CONFIG_BLK_WRITE_LATENCY
+	&queue_sync_write_stats_entry.attr,
+	&queue_async_write_stats_entry.attr,
+#endif
 	NULL,
 };
 
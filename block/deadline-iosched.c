@@ -22,6 +22,7 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 1;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+static const int bg_starved = 8;       /* max times foreground can starve background */
 
 struct deadline_data {
 	/*
@@ -41,6 +42,7 @@ struct deadline_data {
 	unsigned int batching;		/* number of sequential requests made */
 	sector_t last_sector;		/* head position */
 	unsigned int starved;		/* times reads have starved writes */
+	unsigned int bg_skipped;	/* times background was passed over */
 
 	/*
 	 * settings that change how the i/o scheduler behaves
@@ -49,6 +51,7 @@ struct deadline_data {
 	int fifo_batch;
 	int writes_starved;
 	int front_merges;
+	int bg_starved;
 };
 
 static void deadline_move_request(struct deadline_data *, struct request *);
@@ -238,6 +241,33 @@ static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
 	return 0;
 }
 
+/*
+ * If rq is a background (idle class) request, look for the oldest
+ * foreground request of the same direction to serve instead. Background
+ * is passed over at most bg_starved times in a row; the count restarts
+ * whenever a background request is dispatched, by whatever path.
+ */
+static struct request *
+deadline_prefer_foreground(struct deadline_data *dd, struct request *rq)
+{
+	struct request *__rq;
+
+	if (!rq_is_background(rq))
+		return rq;
+
+	if (dd->bg_skipped < dd->bg_starved) {
+		list_for_each_entry(__rq, &dd->fifo_list[rq_data_dir(rq)],
+				    queuelist) {
+			if (!rq_is_background(__rq)) {
+				dd->bg_skipped++;
+				return __rq;
+			}
+		}
+	}
+
+	return rq;
+}
+
 /*
  * deadline_dispatch_requests selects the best request according to
  * read/write expire, fifo_batch, etc
@@ -299,19 +329,25 @@ dispatch_find_request:
 	/*
 	 * we are not running a batch, find best request for selected data_dir
 	 */
-	if (deadline_check_fifo(dd, data_dir) || !dd->next_rq[data_dir]) {
+	if (deadline_check_fifo(dd, data_dir)) {
 		/*
-		 * A deadline has expired, the last request was in the other
-		 * direction, or we have run out of higher-sectored requests.
-		 * Start again from the request with the earliest expiry time.
+		 * A deadline has expired, serve it whatever its priority.
 		 */
 		rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
+	} else if (!dd->next_rq[data_dir]) {
+		/*
+		 * The last request was in the other direction, or we have run
+		 * out of higher-sectored requests. Start again from the request
+		 * with the earliest expiry time.
+		 */
+		rq = deadline_prefer_foreground(dd,
+				rq_entry_fifo(dd->fifo_list[data_dir].next));
 	} else {
 		/*
 		 * The last req was the same dir and we have a next request in
 		 * sort order. No expired requests so continue on from here.
 		 */
-		rq = dd->next_rq[data_dir];
+		rq = deadline_prefer_foreground(dd, dd->next_rq[data_dir]);
 	}
 
 	dd->batching = 0;
@@ -321,6 +357,8 @@ dispatch_request:
 	 * rq is the selected appropriate request.
 	 */
 	dd->batching++;
+	if (rq_is_background(rq))
+		dd->bg_skipped = 0;
 	deadline_move_request(dd, rq);
 
 	return 1;
@@ -364,6 +402,7 @@ static void *deadline_init_queue(struct request_queue *q)
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
+	dd->bg_starved = bg_starved;
 	return dd;
 }
 
@@ -400,6 +439,7 @@ SHOW_FUNCTION(deadline_write_expire_show, dd->fifo_expire[WRITE], 1);
 SHOW_FUNCTION(deadline_writes_starved_show, dd->writes_starved, 0);
 SHOW_FUNCTION(deadline_front_merges_show, dd->front_merges, 0);
 SHOW_FUNCTION(deadline_fifo_batch_show, dd->fifo_batch, 0);
+SHOW_FUNCTION(deadline_bg_starved_show, dd->bg_starved, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -423,6 +463,7 @@ STORE_FUNCTION(deadline_write_expire_store, &dd->fifo_expire[WRITE], 0, INT_MAX,
 STORE_FUNCTION(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX, 0);
 STORE_FUNCTION(deadline_front_merges_store, &dd->front_merges, 0, 1, 0);
 STORE_FUNCTION(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(deadline_bg_starved_store, &dd->bg_starved, 0, INT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -435,6 +476,7 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(bg_starved),
 	__ATTR_NULL
 };
 
@@ -455,6 +497,7 @@ static struct elevator_type iosched_deadline = {
 	.elevator_attrs = deadline_attrs,
 	.elevator_name = "deadline",
 	.elevator_owner = THIS_MODULE,
+	.sync_write_boost = true,
 };
 
 static int __init deadline_init(void)
@@ -0,0 +1,689 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ *
+ *  Flash storage (eMMC, SD, raw NAND behind an FTL) has no seek penalty,
+ *  so requests are never sorted by sector for dispatch. They are served in
+ *  fifo order, reads ahead of writes, sync ahead of async, with the usual
+ *  expiry times and a bound on how long reads may starve writes. Merging
+ *  is kept within erase block sized chunks, and a small sync write that
+ *  does not end on a chunk (or program page) boundary may be held back for
+ *  a few milliseconds so that the rest of the chunk can merge into it.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 4;  /* max time before a read is submitted. */
+static const int write_expire = 2 * HZ; /* ditto for writes, these limits are SOFT! */
+static const int writes_starved = 4;    /* max times reads can starve a write */
+static const int fifo_batch = 4;        /* # of requests served per direction */
+static const int write_coalesce = 2;    /* max ms to hold a small sync write */
+static const int bg_starved = 8;        /* max times foreground can starve background */
+static const int chunk_sectors = 1024;  /* erase block hint, 512KiB */
+
+enum { ASYNC, SYNC };
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list and fifo_list. The
+	 * sort_list is only used to find front merge and request merge
+	 * candidates, never to choose what to dispatch.
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2][2];	/* [sync][data_dir] */
+
+	unsigned int batching;		/* number of requests in this batch */
+	int batch_dir;			/* data direction of this batch */
+	unsigned int starved;		/* times reads have starved writes */
+	unsigned int bg_skipped;	/* times background was passed over */
+
+	/*
+	 * small sync write waiting for the rest of its chunk
+	 */
+	struct request *held_rq;
+	int held_expired;
+	struct timer_list coalesce_timer;
+	struct work_struct unplug_work;
+	struct request_queue *queue;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int fifo_batch;
+	int writes_starved;
+	int front_merges;
+	int write_coalesce;
+	int bg_starved;
+	unsigned int chunk_sectors;	/* erase block, 0 if unknown */
+	unsigned int page_sectors;	/* program page */
+};
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static inline struct list_head *
+flash_fifo(struct flash_data *fd, struct request *rq)
+{
+	return &fd->fifo_list[rq_is_sync(rq)][rq_data_dir(rq)];
+}
+
+static inline int flash_pending(struct flash_data *fd, int data_dir)
+{
+	return !list_empty(&fd->fifo_list[SYNC][data_dir]) ||
+	       !list_empty(&fd->fifo_list[ASYNC][data_dir]);
+}
+
+/*
+ * Returns the chunk number of a sector, or the sector itself when the
+ * erase block size is unknown so that every merge is allowed.
+ */
+static inline sector_t flash_chunk(struct flash_data *fd, sector_t sector)
+{
+	if (fd->chunk_sectors)
+		sector_div(sector, fd->chunk_sectors);
+	return sector;
+}
+
+/*
+ * Would a request covering [start, end) straddle an erase block boundary?
+ */
+static inline int
+flash_crosses_chunk(struct flash_data *fd, sector_t start, sector_t end)
+{
+	if (!fd->chunk_sectors)
+		return 0;
+	return flash_chunk(fd, start) != flash_chunk(fd, end - 1);
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	/*
+	 * An alias can only be a request we'd never have merged with, so
+	 * there is no sector order to keep: just push it to the device.
+	 */
+	while (unlikely(__alias = elv_rb_add(root, rq))) {
+		rq_fifo_clear(__alias);
+		elv_rb_del(root, __alias);
+		if (fd->held_rq == __alias)
+			fd->held_rq = NULL;
+		elv_dispatch_add_tail(rq->q, __alias);
+	}
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, flash_fifo(fd, rq));
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (fd->held_rq == rq)
+		fd->held_rq = NULL;
+	rq_fifo_clear(rq);
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+/*
+ * Only grow a request within the erase block it already covers, so that
+ * merged writes line up with what the FTL programs and erases.
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	sector_t start = min_t(sector_t, blk_rq_pos(rq), bio->bi_sector);
+	sector_t end = max_t(sector_t, rq_end_sector(rq),
+			     bio->bi_sector + bio_sectors(bio));
+
+	return !flash_crosses_chunk(fd, start, end);
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * Request to request merge candidates, limited to the same erase block.
+ */
+static struct request *
+flash_former_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *prev = elv_rb_former_request(q, rq);
+
+	if (prev && flash_crosses_chunk(fd, blk_rq_pos(prev), rq_end_sector(rq)))
+		return NULL;
+	return prev;
+}
+
+static struct request *
+flash_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *next = elv_rb_latter_request(q, rq);
+
+	if (next && flash_crosses_chunk(fd, blk_rq_pos(rq), rq_end_sector(next)))
+		return NULL;
+	return next;
+}
+
+/*
+ * move request from the scheduler to the dispatch queue.
+ */
+static inline void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+static inline int flash_rq_expired(struct request *rq)
+{
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Returns the head of a fifo if it has expired, NULL otherwise.
+ */
+static inline struct request *
+flash_expired_request(struct flash_data *fd, int sync, int data_dir)
+{
+	struct list_head *fifo = &fd->fifo_list[sync][data_dir];
+	struct request *rq;
+
+	if (list_empty(fifo))
+		return NULL;
+
+	rq = rq_entry_fifo(fifo->next);
+	if (flash_rq_expired(rq))
+		return rq;
+
+	return NULL;
+}
+
+/*
+ * Returns the oldest request of a fifo, except that foreground requests
+ * are served ahead of background (idle class) ones, at most bg_starved
+ * times in a row. bg_skipped is only counted once the request is
+ * dispatched, a request chosen here may still be held back.
+ */
+static struct request *
+flash_fifo_request(struct flash_data *fd, int sync, int data_dir)
+{
+	struct list_head *fifo = &fd->fifo_list[sync][data_dir];
+	struct request *rq, *__rq;
+
+	if (list_empty(fifo))
+		return NULL;
+
+	rq = rq_entry_fifo(fifo->next);
+	if (!rq_is_background(rq))
+		return rq;
+
+	if (fd->bg_skipped < fd->bg_starved) {
+		list_for_each_entry(__rq, fifo, queuelist) {
+			if (!rq_is_background(__rq))
+				return __rq;
+		}
+	}
+
+	return rq;
+}
+
+/*
+ * Count a foreground request dispatched ahead of a background one waiting
+ * at the head of its fifo, and start over once background gets its turn.
+ */
+static void flash_account_background(struct flash_data *fd,
+				     struct request *rq)
+{
+	struct list_head *fifo = flash_fifo(fd, rq);
+
+	if (rq_is_background(rq))
+		fd->bg_skipped = 0;
+	else if (rq_is_background(rq_entry_fifo(fifo->next)))
+		fd->bg_skipped++;
+}
+
+/*
+ * Pick the next request of a data direction: expired async requests
+ * first so that background writeback can't be starved forever, then
+ * expired sync ones, then plain fifo order with sync ahead of async.
+ */
+static struct request *flash_choose_request(struct flash_data *fd, int data_dir)
+{
+	struct request *rq;
+
+	rq = flash_expired_request(fd, ASYNC, data_dir);
+	if (rq)
+		return rq;
+	rq = flash_expired_request(fd, SYNC, data_dir);
+	if (rq)
+		return rq;
+
+	rq = flash_fifo_request(fd, SYNC, data_dir);
+	if (rq)
+		return rq;
+
+	return flash_fifo_request(fd, ASYNC, data_dir);
+}
+
+/*
+ * A sync write is worth holding back if it is shorter than the unit the
+ * flash writes in and doesn't end on a boundary of it, i.e. the writer is
+ * likely to send the rest of the chunk (or page) right behind it.
+ */
+static int flash_hold_write(struct flash_data *fd, struct request *rq)
+{
+	unsigned int align = fd->chunk_sectors ? : fd->page_sectors;
+	sector_t end = rq_end_sector(rq);
+
+	if (!fd->write_coalesce || !rq_is_sync(rq) || align <= 1)
+		return 0;
+	if (blk_rq_sectors(rq) >= align || !sector_div(end, align))
+		return 0;
+	if (flash_rq_expired(rq))
+		return 0;
+
+	if (fd->held_rq == rq)
+		return !fd->held_expired;
+
+	fd->held_rq = rq;
+	fd->held_expired = 0;
+	mod_timer(&fd->coalesce_timer,
+		  jiffies + max(1UL, msecs_to_jiffies(fd->write_coalesce)));
+	return 1;
+}
+
+static void flash_kick_queue(struct work_struct *work)
+{
+	struct flash_data *fd =
+		container_of(work, struct flash_data, unplug_work);
+	struct request_queue *q = fd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	__blk_run_queue(q);
+	spin_unlock_irq(q->queue_lock);
+}
+
+/*
+ * The held write waited long enough for its neighbours, let it go.
+ */
+static void flash_coalesce_timer(unsigned long data)
+{
+	struct flash_data *fd = (struct flash_data *) data;
+	unsigned long flags;
+
+	spin_lock_irqsave(fd->queue->queue_lock, flags);
+	fd->held_expired = 1;
+	spin_unlock_irqrestore(fd->queue->queue_lock, flags);
+
+	kblockd_schedule_work(fd->queue, &fd->unplug_work);
+}
+
+/*
+ * flash_dispatch_requests selects the next request according to
+ * read/write expire, fifo_batch, writes_starved and write coalescing.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = flash_pending(fd, READ);
+	const int writes = flash_pending(fd, WRITE);
+	struct request *rq;
+	int data_dir;
+
+	/*
+	 * batches are currently reads XOR writes
+	 */
+	if (fd->batching < fd->fifo_batch) {
+		data_dir = fd->batch_dir;
+		rq = flash_choose_request(fd, data_dir);
+		if (rq && (data_dir == READ || force ||
+			   !flash_hold_write(fd, rq)))
+			goto dispatch_request;
+	}
+
+	/*
+	 * at this point we are not running a batch. select the appropriate
+	 * data direction (read / write)
+	 */
+
+	if (reads) {
+		if (writes && (fd->starved++ >= fd->writes_starved))
+			goto dispatch_writes;
+
+		data_dir = READ;
+
+		goto dispatch_find_request;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+
+	if (writes) {
+dispatch_writes:
+		fd->starved = 0;
+
+		data_dir = WRITE;
+
+		goto dispatch_find_request;
+	}
+
+	return 0;
+
+dispatch_find_request:
+	rq = flash_choose_request(fd, data_dir);
+	BUG_ON(!rq);
+
+	/*
+	 * Hold back a small sync write for the rest of its chunk, unless
+	 * reads are waiting behind it or the queue is being drained.
+	 */
+	if (data_dir == WRITE && !force && flash_hold_write(fd, rq)) {
+		if (!reads)
+			return 0;
+		data_dir = READ;
+		rq = flash_choose_request(fd, data_dir);
+	}
+
+	fd->batch_dir = data_dir;
+	fd->batching = 0;
+
+dispatch_request:
+	/*
+	 * rq is the selected appropriate request.
+	 */
+	fd->batching++;
+	flash_account_background(fd, rq);
+	flash_move_to_dispatch(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return !flash_pending(fd, READ) && !flash_pending(fd, WRITE);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	del_timer_sync(&fd->coalesce_timer);
+	cancel_work_sync(&fd->unplug_work);
+
+	BUG_ON(flash_pending(fd, READ));
+	BUG_ON(flash_pending(fd, WRITE));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[SYNC][READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[SYNC][WRITE]);
+	INIT_LIST_HEAD(&fd->fifo_list[ASYNC][READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[ASYNC][WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+
+	fd->queue = q;
+	init_timer(&fd->coalesce_timer);
+	fd->coalesce_timer.function = flash_coalesce_timer;
+	fd->coalesce_timer.data = (unsigned long) fd;
+	INIT_WORK(&fd->unplug_work, flash_kick_queue);
+
+	fd->fifo_expire[READ] = read_expire;
+	fd->fifo_expire[WRITE] = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->front_merges = 1;
+	fd->fifo_batch = fifo_batch;
+	fd->write_coalesce = write_coalesce;
+	fd->bg_starved = bg_starved;
+
+	/*
+	 * MMC and most flash drivers don't report an optimal i/o size, so
+	 * unless one is given start from a typical eMMC erase group and
+	 * leave the rest to the chunk_sectors tunable. The minimum i/o
+	 * size is the program page, at least 4KiB.
+	 */
+	fd->chunk_sectors = queue_io_opt(q) ? queue_io_opt(q) >> 9 :
+			    chunk_sectors;
+	fd->page_sectors = max_t(unsigned int, queue_io_min(q), 4096) >> 9;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[READ], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+SHOW_FUNCTION(flash_fifo_batch_show, fd->fifo_batch, 0);
+SHOW_FUNCTION(flash_write_coalesce_show, fd->write_coalesce, 0);
+SHOW_FUNCTION(flash_bg_starved_show, fd->bg_starved, 0);
+SHOW_FUNCTION(flash_chunk_sectors_show, fd->chunk_sectors, 0);
+SHOW_FUNCTION(flash_page_sectors_show, fd->page_sectors, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, INT_MIN, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+STORE_FUNCTION(flash_fifo_batch_store, &fd->fifo_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_write_coalesce_store, &fd->write_coalesce, 0, 100, 0);
+STORE_FUNCTION(flash_bg_starved_store, &fd->bg_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_chunk_sectors_store, &fd->chunk_sectors, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_page_sectors_store, &fd->page_sectors, 1, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(front_merges),
+	FD_ATTR(fifo_batch),
+	FD_ATTR(write_coalesce),
+	FD_ATTR(bg_starved),
+	FD_ATTR(chunk_sectors),
+	FD_ATTR(page_sectors),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	flash_former_request,
+		.elevator_latter_req_fn =	flash_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -98,6 +98,7 @@ static struct elevator_type elevator_noop = {
 	},
 	.elevator_name = "noop",
 	.elevator_owner = THIS_MODULE,
+	.sync_write_boost = true,
 };
 
 static int __init noop_init(void)
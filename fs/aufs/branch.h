@@ -159,6 +159,9 @@ int au_br_mod(struct super_block *sb, struct au_opt_mod *mod, int remount,
 static const loff_t au_loff_max = LLONG_MAX;
 
 int au_xib_trunc(struct super_block *sb);
+void au_xcache_init(struct au_sbinfo *sbinfo);
+void au_xcache_fin(struct au_sbinfo *sbinfo);
+int au_xcache_flush(struct super_block *sb, struct super_block *h_sb);
 ssize_t xino_fread(au_readf_t func, struct file *file, void *buf, size_t size,
 		   loff_t *pos);
 ssize_t xino_fwrite(au_writef_t func, struct file *file, void *buf, size_t size,
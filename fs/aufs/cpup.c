@@ -186,11 +186,43 @@ int cpup_iattr(struct dentry *dst, aufs_bindex_t bindex, struct dentry *h_src)
 
 /* ---------------------------------------------------------------------- */
 
+/*
+ * the data is read in chunks of up to AuCpupBufSz bytes, and every blksize
+ * block in the chunk is checked for a hole. the non-zero blocks in a chunk
+ * are written by a single write, which keeps the number of calls into the
+ * branch fs small when a large file is copied-up.
+ */
+#define AuCpupBufSz	(16 * PAGE_SIZE)
+
+static int au_do_copy_write(struct file *dst, char *p, size_t wbytes)
+{
+	int err;
+	size_t b;
+
+	err = 0;
+	while (wbytes) {
+		b = vfsub_write_k(dst, p, wbytes, &dst->f_pos);
+		err = b;
+		if (unlikely(err == -EAGAIN || err == -EINTR)) {
+			if (fatal_signal_pending(current))
+				break;
+			continue;
+		}
+		if (unlikely(err < 0))
+			break;
+		wbytes -= b;
+		p += b;
+		err = 0;
+	}
+
+	return err;
+}
+
 static int au_do_copy_file(struct file *dst, struct file *src, loff_t len,
-			   char *buf, unsigned long blksize)
+			   char *buf, unsigned long bufsz, unsigned long blksize)
 {
 	int err;
-	size_t sz, rbytes, wbytes;
+	size_t sz, rbytes, n, b;
 	unsigned char all_zero;
 	char *p, *zp;
 	struct mutex *h_mtx;
@@ -205,48 +237,54 @@ static int au_do_copy_file(struct file *dst, struct file *src, loff_t len,
 	all_zero = 0;
 	while (len) {
 		AuDbg("len %lld\n", len);
-		sz = blksize;
-		if (len < blksize)
+		sz = bufsz;
+		if (len < bufsz)
 			sz = len;
 
 		rbytes = 0;
-		/* todo: signal_pending? */
 		while (!rbytes || err == -EAGAIN || err == -EINTR) {
+			if (unlikely(fatal_signal_pending(current))) {
+				err = -EINTR;
+				break;
+			}
 			rbytes = vfsub_read_k(src, buf, sz, &src->f_pos);
 			err = rbytes;
 		}
 		if (unlikely(err < 0))
 			break;
 
-		all_zero = 0;
-		if (len >= rbytes && rbytes == blksize)
-			all_zero = !memcmp(buf, zp, rbytes);
-		if (!all_zero) {
-			wbytes = rbytes;
-			p = buf;
-			while (wbytes) {
-				size_t b;
-
-				b = vfsub_write_k(dst, p, wbytes, &dst->f_pos);
-				err = b;
-				/* todo: signal_pending? */
-				if (unlikely(err == -EAGAIN || err == -EINTR))
-					continue;
-				if (unlikely(err < 0))
+		p = buf;
+		len -= rbytes;
+		while (rbytes) {
+			/* gather the non-zero blocks */
+			n = 0;
+			while (n < rbytes) {
+				b = rbytes - n;
+				if (b > blksize)
+					b = blksize;
+				if (b == blksize && !memcmp(p + n, zp, b))
 					break;
-				wbytes -= b;
-				p += b;
+				n += b;
 			}
-		} else {
-			loff_t res;
-
-			AuLabel(hole);
-			res = vfsub_llseek(dst, rbytes, SEEK_CUR);
-			err = res;
-			if (unlikely(res < 0))
-				break;
+			if (n) {
+				all_zero = 0;
+				err = au_do_copy_write(dst, p, n);
+				if (unlikely(err < 0))
+					goto out;
+			} else {
+				loff_t res;
+
+				AuLabel(hole);
+				all_zero = 1;
+				n = blksize;
+				res = vfsub_llseek(dst, n, SEEK_CUR);
+				err = res;
+				if (unlikely(res < 0))
+					goto out;
+			}
+			p += n;
+			rbytes -= n;
 		}
-		len -= rbytes;
 		err = 0;
 	}
 
@@ -259,9 +297,9 @@ static int au_do_copy_file(struct file *dst, struct file *src, loff_t len,
 			/* nfs requires this step to make last hole */
 			/* is this only nfs? */
 			do {
-				/* todo: signal_pending? */
 				err = vfsub_write_k(dst, "\0", 1, &dst->f_pos);
-			} while (err == -EAGAIN || err == -EINTR);
+			} while ((err == -EAGAIN || err == -EINTR)
+				 && !fatal_signal_pending(current));
 			if (err == 1)
 				dst->f_pos--;
 		}
@@ -278,13 +316,14 @@ static int au_do_copy_file(struct file *dst, struct file *src, loff_t len,
 		}
 	}
 
+out:
 	return err;
 }
 
 int au_copy_file(struct file *dst, struct file *src, loff_t len)
 {
 	int err;
-	unsigned long blksize;
+	unsigned long blksize, bufsz;
 	unsigned char do_kfree;
 	char *buf;
 
@@ -293,20 +332,32 @@ int au_copy_file(struct file *dst, struct file *src, loff_t len)
 	if (!blksize || PAGE_SIZE < blksize)
 		blksize = PAGE_SIZE;
 	AuDbg("blksize %lu\n", blksize);
-	do_kfree = (blksize != PAGE_SIZE && blksize >= sizeof(struct iattr *));
-	if (do_kfree)
-		buf = kmalloc(blksize, GFP_NOFS);
-	else
+
+	/* a small file doesn't need a large buffer */
+	bufsz = AuCpupBufSz;
+	if (len < bufsz)
+		bufsz = PAGE_SIZE;
+	do_kfree = 0;
+	buf = NULL;
+	if (bufsz != PAGE_SIZE) {
+		buf = kmalloc(bufsz, GFP_NOFS | __GFP_NOWARN);
+		do_kfree = !!buf;
+	}
+	if (!buf) {
+		/* fallback to a single page */
+		bufsz = PAGE_SIZE;
 		buf = (void *)__get_free_page(GFP_NOFS);
+	}
 	if (unlikely(!buf))
 		goto out;
+	AuDbg("bufsz %lu\n", bufsz);
 
 	if (len > (1 << 22))
 		AuDbg("copying a large file %lld\n", (long long)len);
 
 	src->f_pos = 0;
 	dst->f_pos = 0;
-	err = au_do_copy_file(dst, src, len, buf, blksize);
+	err = au_do_copy_file(dst, src, len, buf, bufsz, blksize);
 	if (do_kfree)
 		kfree(buf);
 	else
@@ -404,6 +455,226 @@ out:
 	return err;
 }
 
+/* ---------------------------------------------------------------------- */
+
+/*
+ * copying a large file takes long, and while au_ready_to_write() copies it
+ * up the dinfo is write-locked and every reader of the file has to wait.
+ * au_cpup_prep() makes the copy before the writer takes the write lock,
+ * into a temporary whiteout-ed name on the branch the copyup will go to.
+ * the readers keep using the lower file meanwhile. then cpup_entry() only
+ * links the copy to the real name, as long as the lower file has not
+ * changed and the dir is still the same.
+ */
+#define AuCpupPrepSz	(1 << 22)
+
+static int au_cpup_prep_link(struct inode *inode, aufs_bindex_t bdst,
+			     struct inode *h_src, loff_t len,
+			     struct inode *h_dir, struct path *h_path)
+{
+	int err;
+	struct au_cpup_prep *prep;
+	struct path tmp_path;
+
+	prep = au_ii(inode)->ii_cpup_prep;
+	if (!prep
+	    || prep->cp_bindex != bdst
+	    || !prep->cp_h_tmp
+	    || prep->cp_h_tmp->d_parent != h_path->dentry->d_parent
+	    || prep->cp_h_src != h_src
+	    || prep->cp_size != i_size_read(h_src)
+	    || !timespec_equal(&prep->cp_mtime, &h_src->i_mtime)
+	    || (len != -1 && len < prep->cp_size))
+		return 0;
+
+	err = vfsub_link(prep->cp_h_tmp, h_dir, h_path);
+	if (unlikely(err))
+		return 0;
+
+	/* au_cpup_prep_put() tries again if this fails */
+	tmp_path.dentry = prep->cp_h_tmp;
+	tmp_path.mnt = h_path->mnt;
+	err = vfsub_unlink(h_dir, &tmp_path, /*force*/0);
+	if (unlikely(err))
+		AuDbg("%.*s, %d\n", AuDLNPair(tmp_path.dentry), err);
+	return 1;
+}
+
+static void au_cpup_prep_unlink(struct au_cpup_prep *prep)
+{
+	int err;
+	struct inode *h_dir;
+	struct path h_path;
+
+	h_path.dentry = prep->cp_h_tmp;
+	h_path.mnt = prep->cp_br->br_mnt;
+	h_dir = prep->cp_h_parent->d_inode;
+	mutex_lock_nested(&h_dir->i_mutex, AuLsc_I_PARENT);
+	err = -ENOENT;
+	if (h_path.dentry->d_inode
+	    && !d_unhashed(h_path.dentry)
+	    && h_path.dentry->d_parent == prep->cp_h_parent)
+		err = vfsub_unlink(h_dir, &h_path, /*force*/0);
+	mutex_unlock(&h_dir->i_mutex);
+	if (unlikely(err && err != -ENOENT))
+		pr_warning("failed removing %.*s(%d), ignored.\n",
+			   AuDLNPair(h_path.dentry), err);
+}
+
+/* copy the lower file to a temporary name on the branch it will go to */
+static int au_cpup_prep_copy(struct au_cpup_prep *prep, struct file *h_src)
+{
+	int err;
+	struct inode *h_dir;
+	struct dentry *h_parent;
+	struct file *h_dst;
+	struct path h_path;
+
+	err = mnt_want_write(prep->cp_br->br_mnt);
+	if (unlikely(err))
+		goto out;
+
+	h_parent = prep->cp_h_parent;
+	h_dir = h_parent->d_inode;
+	h_path.mnt = prep->cp_br->br_mnt;
+	mutex_lock_nested(&h_dir->i_mutex, AuLsc_I_PARENT);
+	h_path.dentry = au_whtmp_lkup(h_parent, prep->cp_br,
+				      &h_src->f_dentry->d_name);
+	err = PTR_ERR(h_path.dentry);
+	if (!IS_ERR(h_path.dentry)) {
+		err = vfsub_create(h_dir, &h_path, S_IRUSR | S_IWUSR);
+		if (unlikely(err))
+			dput(h_path.dentry);
+	}
+	mutex_unlock(&h_dir->i_mutex);
+	if (unlikely(err))
+		goto out_mnt;
+	prep->cp_h_tmp = h_path.dentry;
+
+	h_dst = vfsub_dentry_open(&h_path, O_WRONLY | O_NOATIME | O_LARGEFILE);
+	err = PTR_ERR(h_dst);
+	if (!IS_ERR(h_dst)) {
+		err = au_copy_file(h_dst, h_src, prep->cp_size);
+		fput(h_dst);
+	}
+	if (unlikely(err)) {
+		au_cpup_prep_unlink(prep);
+		dput(prep->cp_h_tmp);
+		prep->cp_h_tmp = NULL;
+	}
+
+out_mnt:
+	mnt_drop_write(prep->cp_br->br_mnt);
+out:
+	return err;
+}
+
+/*
+ * called by the writers with the inode mutex and si read lock held, before
+ * they lock the file and dentry. returns NULL when there is nothing to do
+ * beforehand, the copyup then runs as usual.
+ */
+struct au_cpup_prep *au_cpup_prep(struct file *file)
+{
+	int err;
+	aufs_bindex_t bstart, bcpup;
+	struct dentry *dentry, *parent, *h_parent;
+	struct inode *inode, *h_inode;
+	struct super_block *sb;
+	struct file *h_file;
+	struct au_cpup_prep *prep;
+
+	prep = NULL;
+	dentry = file->f_dentry;
+	inode = dentry->d_inode;
+	if (!S_ISREG(inode->i_mode))
+		goto out;
+	sb = dentry->d_sb;
+	err = au_reval_and_lock_fdi(file, au_reopen_nondir, /*wlock*/0);
+	if (unlikely(err))
+		goto out;
+
+	bstart = au_fbstart(file);
+	if (d_unhashed(dentry)
+	    || inode->i_nlink != 1
+	    || bstart != au_dbstart(dentry)
+	    || !au_test_ro(sb, bstart, inode))
+		goto out_unlock;
+	h_inode = au_h_dptr(dentry, bstart)->d_inode;
+	if (!h_inode
+	    || !S_ISREG(h_inode->i_mode)
+	    || i_size_read(h_inode) < AuCpupPrepSz)
+		goto out_unlock;
+
+	parent = dget_parent(dentry);
+	di_read_lock_parent(parent, !AuLock_IR);
+	bcpup = AuWbrCopyup(au_sbi(sb), dentry);
+	h_parent = NULL;
+	if (bcpup >= 0 && bcpup < bstart && !au_hi_wh(inode, bcpup))
+		h_parent = au_h_dptr(parent, bcpup);
+	if (h_parent && h_parent->d_inode) {
+		prep = kzalloc(sizeof(*prep), GFP_NOFS);
+		if (prep) {
+			prep->cp_bindex = bcpup;
+			prep->cp_br = au_sbr(sb, bcpup);
+			prep->cp_h_parent = dget(h_parent);
+			prep->cp_h_src = au_igrab(h_inode);
+			prep->cp_size = i_size_read(h_inode);
+			prep->cp_mtime = h_inode->i_mtime;
+		}
+	}
+	di_read_unlock(parent, !AuLock_IR);
+	dput(parent);
+	if (!prep)
+		goto out_unlock;
+
+	h_file = au_h_open(dentry, bstart, O_RDONLY | O_NOATIME | O_LARGEFILE,
+			   /*file*/NULL);
+	di_read_unlock(dentry, AuLock_IR);
+	fi_read_unlock(file);
+	if (IS_ERR(h_file))
+		goto out_put;
+
+	/*
+	 * the aufs locks are released, only the inode mutex stays. the
+	 * branch cannot be removed while the si read lock is held.
+	 */
+	err = au_cpup_prep_copy(prep, h_file);
+	fput(h_file);
+	au_sbr_put(sb, bstart);
+	if (!err)
+		goto out; /* success */
+
+out_put:
+	au_cpup_prep_put(prep);
+	prep = NULL;
+	goto out;
+
+out_unlock:
+	di_read_unlock(dentry, AuLock_IR);
+	fi_read_unlock(file);
+out:
+	return prep;
+}
+
+/* removes the copy if the copyup did not use it */
+void au_cpup_prep_put(struct au_cpup_prep *prep)
+{
+	if (!prep)
+		return;
+
+	if (prep->cp_h_tmp) {
+		if (!mnt_want_write(prep->cp_br->br_mnt)) {
+			au_cpup_prep_unlink(prep);
+			mnt_drop_write(prep->cp_br->br_mnt);
+		}
+		dput(prep->cp_h_tmp);
+	}
+	dput(prep->cp_h_parent);
+	iput(prep->cp_h_src);
+	kfree(prep);
+}
+
 static int au_do_cpup_symlink(struct path *h_path, struct dentry *h_src,
 			      struct inode *h_dir)
 {
@@ -482,6 +753,11 @@ int cpup_entry(struct dentry *dentry, aufs_bindex_t bdst,
 	case S_IFREG:
 		/* try stopping to update while we are referencing */
 		IMustLock(h_inode);
+		if (au_cpup_prep_link(dentry->d_inode, bdst, h_inode, len,
+				      h_dir, &h_path) > 0) {
+			err = 0;
+			break;
+		}
 		err = vfsub_create(h_dir, &h_path, mode | S_IWUSR);
 		if (!err)
 			err = au_do_cpup_regular
@@ -60,6 +60,22 @@ int au_sio_cpup_simple(struct dentry *dentry, aufs_bindex_t bdst, loff_t len,
 int au_sio_cpup_wh(struct dentry *dentry, aufs_bindex_t bdst, loff_t len,
 		   struct file *file);
 
+/* a copy of a large file made before it is copied-up */
+struct au_branch;
+struct au_cpup_prep {
+	aufs_bindex_t		cp_bindex;
+	struct au_branch	*cp_br;
+	struct dentry		*cp_h_parent;
+	struct dentry		*cp_h_tmp;
+
+	/* the lower file when it was copied */
+	struct inode		*cp_h_src;
+	loff_t			cp_size;
+	struct timespec		cp_mtime;
+};
+struct au_cpup_prep *au_cpup_prep(struct file *file);
+void au_cpup_prep_put(struct au_cpup_prep *prep);
+
 int au_cp_dirs(struct dentry *dentry, aufs_bindex_t bdst,
 	       int (*cp)(struct dentry *dentry, aufs_bindex_t bdst,
 			 struct dentry *h_parent, void *arg),
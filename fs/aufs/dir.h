@@ -83,6 +83,11 @@ struct au_vdir {
 	unsigned long	vd_version;
 	unsigned int	vd_deblk_sz;
 	unsigned long	vd_jiffy;
+
+	/* the super generation when the entries were read */
+	unsigned int	vd_sigen;
+	/* set by hnotify when a branch dir is changed */
+	unsigned char	vd_stale;
 } ____cacheline_aligned_in_smp;
 
 /* ---------------------------------------------------------------------- */
@@ -171,6 +171,7 @@ static ssize_t aufs_write(struct file *file, const char __user *ubuf,
 {
 	ssize_t err;
 	struct au_pin pin;
+	struct au_cpup_prep *prep;
 	struct dentry *dentry;
 	struct inode *inode;
 	struct file *h_file;
@@ -179,12 +180,13 @@ static ssize_t aufs_write(struct file *file, const char __user *ubuf,
 	dentry = file->f_dentry;
 	inode = dentry->d_inode;
 	au_mtx_and_read_lock(inode);
+	prep = au_cpup_prep(file);
 
 	err = au_reval_and_lock_fdi(file, au_reopen_nondir, /*wlock*/1);
 	if (unlikely(err))
 		goto out;
 
-	err = au_ready_to_write(file, -1, &pin);
+	err = au_ready_to_write(file, -1, &pin, prep);
 	di_downgrade_lock(dentry, AuLock_IR);
 	if (unlikely(err))
 		goto out_unlock;
@@ -199,6 +201,7 @@ out_unlock:
 	di_read_unlock(dentry, AuLock_IR);
 	fi_write_unlock(file);
 out:
+	au_cpup_prep_put(prep);
 	si_read_unlock(inode->i_sb);
 	mutex_unlock(&inode->i_mutex);
 	return err;
@@ -269,6 +272,7 @@ static ssize_t aufs_aio_write(struct kiocb *kio, const struct iovec *iov,
 {
 	ssize_t err;
 	struct au_pin pin;
+	struct au_cpup_prep *prep;
 	struct dentry *dentry;
 	struct inode *inode;
 	struct file *file, *h_file;
@@ -277,12 +281,13 @@ static ssize_t aufs_aio_write(struct kiocb *kio, const struct iovec *iov,
 	dentry = file->f_dentry;
 	inode = dentry->d_inode;
 	au_mtx_and_read_lock(inode);
+	prep = au_cpup_prep(file);
 
 	err = au_reval_and_lock_fdi(file, au_reopen_nondir, /*wlock*/1);
 	if (unlikely(err))
 		goto out;
 
-	err = au_ready_to_write(file, -1, &pin);
+	err = au_ready_to_write(file, -1, &pin, prep);
 	di_downgrade_lock(dentry, AuLock_IR);
 	if (unlikely(err))
 		goto out_unlock;
@@ -297,6 +302,7 @@ out_unlock:
 	di_read_unlock(dentry, AuLock_IR);
 	fi_write_unlock(file);
 out:
+	au_cpup_prep_put(prep);
 	si_read_unlock(inode->i_sb);
 	mutex_unlock(&inode->i_mutex);
 	return err;
@@ -343,6 +349,7 @@ aufs_splice_write(struct pipe_inode_info *pipe, struct file *file, loff_t *ppos,
 {
 	ssize_t err;
 	struct au_pin pin;
+	struct au_cpup_prep *prep;
 	struct dentry *dentry;
 	struct inode *inode;
 	struct file *h_file;
@@ -350,11 +357,12 @@ aufs_splice_write(struct pipe_inode_info *pipe, struct file *file, loff_t *ppos,
 	dentry = file->f_dentry;
 	inode = dentry->d_inode;
 	au_mtx_and_read_lock(inode);
+	prep = au_cpup_prep(file);
 	err = au_reval_and_lock_fdi(file, au_reopen_nondir, /*wlock*/1);
 	if (unlikely(err))
 		goto out;
 
-	err = au_ready_to_write(file, -1, &pin);
+	err = au_ready_to_write(file, -1, &pin, prep);
 	di_downgrade_lock(dentry, AuLock_IR);
 	if (unlikely(err))
 		goto out_unlock;
@@ -369,6 +377,7 @@ out_unlock:
 	di_read_unlock(dentry, AuLock_IR);
 	fi_write_unlock(file);
 out:
+	au_cpup_prep_put(prep);
 	si_read_unlock(inode->i_sb);
 	mutex_unlock(&inode->i_mutex);
 	return err;
@@ -629,7 +638,7 @@ static int au_mmap_pre(struct file *file, struct vm_area_struct *vma,
 	if (wlock) {
 		struct au_pin pin;
 
-		err = au_ready_to_write(file, -1, &pin);
+		err = au_ready_to_write(file, -1, &pin, /*prep*/NULL);
 		di_write_unlock(dentry);
 		if (unlikely(err))
 			goto out_unlock;
@@ -763,7 +772,7 @@ static int aufs_fsync_nondir(struct file *file, int datasync)
 	if (unlikely(err))
 		goto out_si;
 
-	err = au_ready_to_write(file, -1, &pin);
+	err = au_ready_to_write(file, -1, &pin, /*prep*/NULL);
 	di_downgrade_lock(dentry, AuLock_IR);
 	if (unlikely(err))
 		goto out_unlock;
@@ -823,7 +832,7 @@ static int aufs_aio_fsync_nondir(struct kiocb *kio, int datasync)
 	if (unlikely(err))
 		goto out;
 
-	err = au_ready_to_write(file, -1, &pin);
+	err = au_ready_to_write(file, -1, &pin, /*prep*/NULL);
 	di_downgrade_lock(dentry, AuLock_IR);
 	if (unlikely(err))
 		goto out_unlock;
@@ -231,8 +231,10 @@ static int au_ready_to_write_wh(struct file *file, loff_t len,
 
 /*
  * prepare the @file for writing.
+ * @prep is a copy made by au_cpup_prep() for the copyup to use, or NULL.
  */
-int au_ready_to_write(struct file *file, loff_t len, struct au_pin *pin)
+int au_ready_to_write(struct file *file, loff_t len, struct au_pin *pin,
+		      struct au_cpup_prep *prep)
 {
 	int err;
 	aufs_bindex_t bstart, bcpup, dbstart;
@@ -293,9 +295,12 @@ int au_ready_to_write(struct file *file, loff_t len, struct au_pin *pin)
 			h_file = NULL;
 		} else {
 			di_downgrade_lock(parent, AuLock_IR);
-			if (dbstart > bcpup)
+			if (dbstart > bcpup) {
+				au_ii(inode)->ii_cpup_prep = prep;
 				err = au_sio_cpup_simple(dentry, bcpup, len,
 							 AuCpup_DTIME);
+				au_ii(inode)->ii_cpup_prep = NULL;
+			}
 			if (!err)
 				err = au_reopen_nondir(file);
 		}
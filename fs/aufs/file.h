@@ -77,7 +77,9 @@ int au_do_open(struct file *file, int (*open)(struct file *file, int flags),
 	       struct au_fidir *fidir);
 int au_reopen_nondir(struct file *file);
 struct au_pin;
-int au_ready_to_write(struct file *file, loff_t len, struct au_pin *pin);
+struct au_cpup_prep;
+int au_ready_to_write(struct file *file, loff_t len, struct au_pin *pin,
+		      struct au_cpup_prep *prep);
 int au_reval_and_lock_fdi(struct file *file, int (*reopen)(struct file *file),
 			  int wlock);
 int au_do_flush(struct file *file, fl_owner_t id,
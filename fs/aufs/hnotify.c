@@ -340,7 +340,7 @@ static int hn_job(struct hn_job_args *a)
 
 		vdir = au_ivdir(a->inode);
 		if (vdir)
-			vdir->vd_jiffy = 0;
+			vdir->vd_stale = 1;
 		/* IMustLock(a->inode); */
 		/* a->inode->i_version++; */
 	}
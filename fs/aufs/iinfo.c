@@ -191,6 +191,7 @@ int au_iinfo_init(struct inode *inode)
 		iinfo->ii_bstart = -1;
 		iinfo->ii_bend = -1;
 		iinfo->ii_vdir = NULL;
+		iinfo->ii_cpup_prep = NULL;
 		return 0;
 	}
 	return -ENOMEM;
@@ -46,6 +46,7 @@ void au_si_free(struct kobject *kobj)
 
 	kfree(sbinfo->si_branch);
 	kfree(sbinfo->au_si_pid.bitmap);
+	au_xcache_fin(sbinfo);
 	mutex_destroy(&sbinfo->si_xib_mtx);
 	AuRwDestroy(&sbinfo->si_rwsem);
 
@@ -100,6 +101,7 @@ int au_si_alloc(struct super_block *sb)
 
 	mutex_init(&sbinfo->si_xib_mtx);
 	sbinfo->si_xino_brid = -1;
+	au_xcache_init(sbinfo);
 	/* leave si_xib_last_pindex and si_xib_next_bit */
 
 	sbinfo->si_rdcache = msecs_to_jiffies(AUFS_RDCACHE_DEF * MSEC_PER_SEC);
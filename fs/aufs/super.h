@@ -56,6 +56,11 @@ struct au_wbr_mfs {
 	unsigned long long	mfsrr_watermark;
 };
 
+/* in-memory cache of the xino files, see xino.c */
+#define AuXcache_NHASH		256
+#define AuXcache_MAX		2048	/* entries */
+#define AuXcache_BATCH		64	/* dirty entries */
+
 struct au_branch;
 struct au_sbinfo {
 	/* nowait tasks in the system-wide workqueue */
@@ -117,6 +122,10 @@ struct au_sbinfo {
 	unsigned long		si_xib_last_pindex;
 	int			si_xib_next_bit;
 	aufs_bindex_t		si_xino_brid;
+	struct mutex		si_xcache_mtx; /* protect xcache members */
+	struct list_head	si_xcache_lru;
+	unsigned int		si_xcache_n, si_xcache_ndirty;
+	struct hlist_head	si_xcache[AuXcache_NHASH];
 	/* reserved for future use */
 	/* unsigned long long	si_xib_limit; */	/* Max xib file size */
 
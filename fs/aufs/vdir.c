@@ -393,6 +393,8 @@ static struct au_vdir *alloc_vdir(struct file *file)
 	vdir->vd_nblk = 0;
 	vdir->vd_version = 0;
 	vdir->vd_jiffy = 0;
+	vdir->vd_sigen = 0;
+	vdir->vd_stale = 0;
 	err = append_deblk(vdir);
 	if (!err)
 		return vdir; /* success */
@@ -424,6 +426,8 @@ static int reinit_vdir(struct au_vdir *vdir)
 	vdir->vd_last.p.deblk = vdir->vd_deblk[0];
 	vdir->vd_version = 0;
 	vdir->vd_jiffy = 0;
+	vdir->vd_sigen = 0;
+	vdir->vd_stale = 0;
 	/* smp_mb(); */
 	return err;
 }
@@ -623,10 +627,31 @@ out:
 	return err;
 }
 
+/*
+ * the merged entries are kept until the dir or the branches are changed.
+ * the changes made through aufs increment i_version, and adding/deleting a
+ * branch or a remount increments the super generation. with udba=notify,
+ * the changes made on the branches directly reach hn_job() which marks the
+ * entries stale, so they never expire by time. otherwise aufs cannot know
+ * them and the entries expire after rdcache seconds.
+ */
+static int vdir_stale(struct inode *inode, struct au_vdir *vdir)
+{
+	struct super_block *sb;
+
+	sb = inode->i_sb;
+	if (vdir->vd_stale
+	    || inode->i_version != vdir->vd_version
+	    || vdir->vd_sigen != au_sigen(sb))
+		return 1;
+	if (au_opt_test(au_mntflags(sb), UDBA_HNOTIFY))
+		return 0;
+	return time_after(jiffies, vdir->vd_jiffy + au_sbi(sb)->si_rdcache);
+}
+
 static int read_vdir(struct file *file, int may_read)
 {
 	int err;
-	unsigned long expire;
 	unsigned char do_read;
 	struct fillvdir_arg arg;
 	struct inode *inode;
@@ -639,7 +664,6 @@ static int read_vdir(struct file *file, int may_read)
 
 	allocated = NULL;
 	do_read = 0;
-	expire = au_sbi(inode->i_sb)->si_rdcache;
 	vdir = au_ivdir(inode);
 	if (!vdir) {
 		do_read = 1;
@@ -649,9 +673,7 @@ static int read_vdir(struct file *file, int may_read)
 			goto out;
 		err = 0;
 		allocated = vdir;
-	} else if (may_read
-		   && (inode->i_version != vdir->vd_version
-		       || time_after(jiffies, vdir->vd_jiffy + expire))) {
+	} else if (may_read && vdir_stale(inode, vdir)) {
 		do_read = 1;
 		err = reinit_vdir(vdir);
 		if (unlikely(err))
@@ -667,6 +689,11 @@ static int read_vdir(struct file *file, int may_read)
 	if (!err) {
 		/* file->f_pos = 0; */
 		vdir->vd_version = inode->i_version;
+		vdir->vd_sigen = au_sigen(inode->i_sb);
+		/*
+		 * vd_stale was cleared before reading, leave it alone so that
+		 * a notification which came in meanwhile is not lost.
+		 */
 		vdir->vd_last.ul = 0;
 		vdir->vd_last.p.deblk = vdir->vd_deblk[0];
 		if (allocated)
@@ -21,6 +21,7 @@
  */
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include "aufs.h"
@@ -258,6 +259,10 @@ int au_xino_trunc(struct super_block *sb, aufs_bindex_t bindex)
 	if (!file)
 		goto out;
 
+	err = au_xcache_flush(sb, br->br_mnt->mnt_sb);
+	if (unlikely(err))
+		goto out;
+
 	au_xino_lock_dir(sb, file, &ldir);
 	/* mnt_want_write() is unnecessary here */
 	new_xino = au_xino_create2(file, file);
@@ -381,37 +386,263 @@ static int au_xino_do_write(au_writef_t write, struct file *file,
 	return -EIO;
 }
 
+/*
+ * in-memory cache in front of the xino files.
+ * the entries are keyed by the branch fs and the inode number on it, since
+ * the branches on the same fs share a xino file.
+ * au_xino_write() updates the cache only, and the dirty entries are written
+ * back in a batch, when they are evicted, or before the xino files are read
+ * or copied directly. "no entry" beyond the end of the xino file is never
+ * written, it would only extend the file.
+ */
+struct au_xcache {
+	struct hlist_node	xc_hnode;
+	struct list_head	xc_lru;
+	struct super_block	*xc_h_sb;
+	ino_t			xc_h_ino;
+	ino_t			xc_ino;
+	unsigned char		xc_dirty;
+};
+
+static struct hlist_head *xcache_head(struct au_sbinfo *sbinfo,
+				      struct super_block *h_sb, ino_t h_ino)
+{
+	unsigned long v;
+
+	v = (unsigned long)h_ino ^ ((unsigned long)h_sb / L1_CACHE_BYTES);
+	return sbinfo->si_xcache + hash_long(v, ilog2(AuXcache_NHASH));
+}
+
+static struct au_xcache *xcache_find(struct au_sbinfo *sbinfo,
+				     struct super_block *h_sb, ino_t h_ino)
+{
+	struct au_xcache *xc;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(xc, pos, xcache_head(sbinfo, h_sb, h_ino),
+			     xc_hnode)
+		if (xc->xc_h_ino == h_ino && xc->xc_h_sb == h_sb) {
+			list_move(&xc->xc_lru, &sbinfo->si_xcache_lru);
+			return xc;
+		}
+	return NULL;
+}
+
+static int xcache_writeback(struct super_block *sb, struct au_xcache *xc)
+{
+	int err;
+	loff_t pos;
+	aufs_bindex_t bindex, bend;
+	struct au_sbinfo *sbinfo;
+	struct au_branch *br;
+	struct file *file;
+
+	err = 0;
+	if (!xc->xc_dirty)
+		goto out;
+
+	sbinfo = au_sbi(sb);
+	xc->xc_dirty = 0;
+	sbinfo->si_xcache_ndirty--;
+	br = NULL;
+	bend = au_sbend(sb);
+	for (bindex = 0; bindex <= bend; bindex++) {
+		br = au_sbr(sb, bindex);
+		if (br->br_mnt->mnt_sb == xc->xc_h_sb && br->br_xino.xi_file)
+			break;
+	}
+	if (bindex > bend)
+		goto out; /* the branch is removed */
+
+	file = br->br_xino.xi_file;
+	pos = xc->xc_h_ino;
+	pos *= sizeof(xc->xc_ino);
+	if (!xc->xc_ino
+	    && i_size_read(file->f_dentry->d_inode) < pos + sizeof(xc->xc_ino))
+		goto out;
+
+	err = au_xino_do_write(sbinfo->si_xwrite, file, xc->xc_h_ino,
+			       xc->xc_ino);
+	if (!err
+	    && au_opt_test(au_mntflags(sb), TRUNC_XINO)
+	    && au_test_fs_trunc_xino(br->br_mnt->mnt_sb))
+		xino_try_trunc(sb, br);
+
+out:
+	return err;
+}
+
+static int xcache_do_flush(struct super_block *sb, struct super_block *h_sb)
+{
+	int err, e;
+	struct au_sbinfo *sbinfo;
+	struct au_xcache *xc;
+
+	sbinfo = au_sbi(sb);
+	MtxMustLock(&sbinfo->si_xcache_mtx);
+
+	err = 0;
+	list_for_each_entry(xc, &sbinfo->si_xcache_lru, xc_lru) {
+		if (!sbinfo->si_xcache_ndirty)
+			break;
+		if (h_sb && xc->xc_h_sb != h_sb)
+			continue;
+		e = xcache_writeback(sb, xc);
+		if (unlikely(e && !err))
+			err = e;
+	}
+
+	return err;
+}
+
+/* write back the dirty entries of @h_sb, or all of them if @h_sb is NULL */
+int au_xcache_flush(struct super_block *sb, struct super_block *h_sb)
+{
+	int err;
+	struct au_sbinfo *sbinfo;
+
+	SiMustAnyLock(sb);
+
+	sbinfo = au_sbi(sb);
+	mutex_lock(&sbinfo->si_xcache_mtx);
+	err = xcache_do_flush(sb, h_sb);
+	mutex_unlock(&sbinfo->si_xcache_mtx);
+
+	return err;
+}
+
+/* forget the entries without writing them back */
+static void xcache_drop(struct au_sbinfo *sbinfo, struct super_block *h_sb)
+{
+	struct au_xcache *xc, *tmp;
+
+	list_for_each_entry_safe(xc, tmp, &sbinfo->si_xcache_lru, xc_lru) {
+		if (h_sb && xc->xc_h_sb != h_sb)
+			continue;
+		if (xc->xc_dirty)
+			sbinfo->si_xcache_ndirty--;
+		sbinfo->si_xcache_n--;
+		hlist_del(&xc->xc_hnode);
+		list_del(&xc->xc_lru);
+		kfree(xc);
+	}
+}
+
+/* returns NULL when the cache is unavailable, and the caller bypasses it */
+static struct au_xcache *xcache_add(struct super_block *sb,
+				    struct super_block *h_sb, ino_t h_ino,
+				    ino_t ino)
+{
+	struct au_sbinfo *sbinfo;
+	struct au_xcache *xc;
+
+	sbinfo = au_sbi(sb);
+	if (sbinfo->si_xcache_n >= AuXcache_MAX) {
+		/* reuse the least recently used one */
+		xc = list_entry(sbinfo->si_xcache_lru.prev, struct au_xcache,
+				xc_lru);
+		if (unlikely(xcache_writeback(sb, xc)))
+			return NULL;
+		hlist_del(&xc->xc_hnode);
+		list_del(&xc->xc_lru);
+	} else {
+		xc = kmalloc(sizeof(*xc), GFP_NOFS);
+		if (unlikely(!xc))
+			return NULL;
+		sbinfo->si_xcache_n++;
+	}
+
+	xc->xc_h_sb = h_sb;
+	xc->xc_h_ino = h_ino;
+	xc->xc_ino = ino;
+	xc->xc_dirty = 0;
+	hlist_add_head(&xc->xc_hnode, xcache_head(sbinfo, h_sb, h_ino));
+	list_add(&xc->xc_lru, &sbinfo->si_xcache_lru);
+	return xc;
+}
+
+static int xcache_set(struct super_block *sb, struct au_branch *br,
+		      ino_t h_ino, ino_t ino)
+{
+	int err;
+	struct au_sbinfo *sbinfo;
+	struct au_xcache *xc;
+	struct super_block *h_sb;
+
+	if (unlikely(au_loff_max / sizeof(ino) - 1 < h_ino)) {
+		AuIOErr1("too large hi%lu\n", (unsigned long)h_ino);
+		return -EFBIG;
+	}
+
+	err = 0;
+	sbinfo = au_sbi(sb);
+	h_sb = br->br_mnt->mnt_sb;
+	mutex_lock(&sbinfo->si_xcache_mtx);
+	xc = xcache_find(sbinfo, h_sb, h_ino);
+	if (!xc)
+		xc = xcache_add(sb, h_sb, h_ino, ino);
+	if (unlikely(!xc)) {
+		/* write through */
+		err = au_xino_do_write(sbinfo->si_xwrite, br->br_xino.xi_file,
+				       h_ino, ino);
+		goto out;
+	}
+
+	xc->xc_ino = ino;
+	if (!xc->xc_dirty) {
+		xc->xc_dirty = 1;
+		sbinfo->si_xcache_ndirty++;
+	}
+	if (sbinfo->si_xcache_ndirty >= AuXcache_BATCH)
+		err = xcache_do_flush(sb, /*h_sb*/NULL);
+
+out:
+	mutex_unlock(&sbinfo->si_xcache_mtx);
+	return err;
+}
+
+void au_xcache_init(struct au_sbinfo *sbinfo)
+{
+	int i;
+
+	mutex_init(&sbinfo->si_xcache_mtx);
+	INIT_LIST_HEAD(&sbinfo->si_xcache_lru);
+	sbinfo->si_xcache_n = 0;
+	sbinfo->si_xcache_ndirty = 0;
+	for (i = 0; i < AuXcache_NHASH; i++)
+		INIT_HLIST_HEAD(sbinfo->si_xcache + i);
+}
+
+void au_xcache_fin(struct au_sbinfo *sbinfo)
+{
+	xcache_drop(sbinfo, /*h_sb*/NULL);
+	AuDebugOn(sbinfo->si_xcache_n || sbinfo->si_xcache_ndirty);
+	mutex_destroy(&sbinfo->si_xcache_mtx);
+}
+
 /*
  * write @ino to the xinofile for the specified branch{@sb, @bindex}
  * at the position of @h_ino.
  * even if @ino is zero, it is written to the xinofile and means no entry.
- * if the size of the xino file on a specific filesystem exceeds the watermark,
- * try truncating it.
+ * the write goes to the cache first, and when the dirty entries are written
+ * back, if the size of the xino file on a specific filesystem exceeds the
+ * watermark, try truncating it.
  */
 int au_xino_write(struct super_block *sb, aufs_bindex_t bindex, ino_t h_ino,
 		  ino_t ino)
 {
 	int err;
-	unsigned int mnt_flags;
-	struct au_branch *br;
 
 	BUILD_BUG_ON(sizeof(long long) != sizeof(au_loff_max)
 		     || ((loff_t)-1) > 0);
 	SiMustAnyLock(sb);
 
-	mnt_flags = au_mntflags(sb);
-	if (!au_opt_test(mnt_flags, XINO))
+	if (!au_opt_test(au_mntflags(sb), XINO))
 		return 0;
 
-	br = au_sbr(sb, bindex);
-	err = au_xino_do_write(au_sbi(sb)->si_xwrite, br->br_xino.xi_file,
-			       h_ino, ino);
-	if (!err) {
-		if (au_opt_test(mnt_flags, TRUNC_XINO)
-		    && au_test_fs_trunc_xino(br->br_mnt->mnt_sb))
-			xino_try_trunc(sb, br);
+	err = xcache_set(sb, au_sbr(sb, bindex), h_ino, ino);
+	if (!err)
 		return 0; /* success */
-	}
 
 	AuIOErr("write failed (%d)\n", err);
 	return -EIO;
@@ -512,16 +743,12 @@ static void au_xib_clear_bit(struct inode *inode)
 /* for s_op->delete_inode() */
 void au_xino_delete_inode(struct inode *inode, const int unlinked)
 {
-	int err;
 	unsigned int mnt_flags;
 	aufs_bindex_t bindex, bend, bi;
-	unsigned char try_trunc;
 	struct au_iinfo *iinfo;
 	struct super_block *sb;
 	struct au_hinode *hi;
 	struct inode *h_inode;
-	struct au_branch *br;
-	au_writef_t xwrite;
 
 	sb = inode->i_sb;
 	mnt_flags = au_mntflags(sb);
@@ -542,8 +769,6 @@ void au_xino_delete_inode(struct inode *inode, const int unlinked)
 	if (bindex < 0)
 		return;
 
-	xwrite = au_sbi(sb)->si_xwrite;
-	try_trunc = !!au_opt_test(mnt_flags, TRUNC_XINO);
 	hi = iinfo->ii_hinode + bindex;
 	bend = iinfo->ii_bend;
 	for (; bindex <= bend; bindex++, hi++) {
@@ -557,12 +782,8 @@ void au_xino_delete_inode(struct inode *inode, const int unlinked)
 		if (bi < 0)
 			continue;
 
-		br = au_sbr(sb, bi);
-		err = au_xino_do_write(xwrite, br->br_xino.xi_file,
-				       h_inode->i_ino, /*ino*/0);
-		if (!err && try_trunc
-		    && au_test_fs_trunc_xino(br->br_mnt->mnt_sb))
-			xino_try_trunc(sb, br);
+		xcache_set(sb, au_sbr(sb, bi), h_inode->i_ino, /*ino*/0);
+		/* ignore this error */
 	}
 }
 
@@ -637,6 +858,8 @@ int au_xino_read(struct super_block *sb, aufs_bindex_t bindex, ino_t h_ino,
 	loff_t pos;
 	struct file *file;
 	struct au_sbinfo *sbinfo;
+	struct au_branch *br;
+	struct au_xcache *xc;
 
 	*ino = 0;
 	if (!au_opt_test(au_mntflags(sb), XINO))
@@ -651,20 +874,33 @@ int au_xino_read(struct super_block *sb, aufs_bindex_t bindex, ino_t h_ino,
 	}
 	pos *= sizeof(*ino);
 
-	file = au_sbr(sb, bindex)->br_xino.xi_file;
-	if (i_size_read(file->f_dentry->d_inode) < pos + sizeof(*ino))
-		return 0; /* no ino */
-
-	sz = xino_fread(sbinfo->si_xread, file, ino, sizeof(*ino), &pos);
-	if (sz == sizeof(*ino))
-		return 0; /* success */
+	br = au_sbr(sb, bindex);
+	mutex_lock(&sbinfo->si_xcache_mtx);
+	xc = xcache_find(sbinfo, br->br_mnt->mnt_sb, h_ino);
+	if (xc) {
+		*ino = xc->xc_ino;
+		goto out; /* success */
+	}
 
-	err = sz;
-	if (unlikely(sz >= 0)) {
-		err = -EIO;
-		AuIOErr("xino read error (%zd)\n", sz);
+	file = br->br_xino.xi_file;
+	if (i_size_read(file->f_dentry->d_inode) >= pos + sizeof(*ino)) {
+		sz = xino_fread(sbinfo->si_xread, file, ino, sizeof(*ino),
+				&pos);
+		if (unlikely(sz != sizeof(*ino))) {
+			*ino = 0;
+			err = sz;
+			if (unlikely(sz >= 0)) {
+				err = -EIO;
+				AuIOErr("xino read error (%zd)\n", sz);
+			}
+			goto out;
+		}
 	}
+	/* "no ino" is cached too, ignore the failure */
+	xcache_add(sb, br->br_mnt->mnt_sb, h_ino, *ino);
 
+out:
+	mutex_unlock(&sbinfo->si_xcache_mtx);
 	return err;
 }
 
@@ -779,6 +1015,13 @@ int au_xino_br(struct super_block *sb, struct au_branch *br, ino_t h_ino,
 
 	if (!shared_br || !shared_br->br_xino.xi_file) {
 		struct au_xino_lock_dir ldir;
+		struct au_sbinfo *sbinfo;
+
+		/* the entries left by a removed branch on the same fs */
+		sbinfo = au_sbi(sb);
+		mutex_lock(&sbinfo->si_xcache_mtx);
+		xcache_drop(sbinfo, br->br_mnt->mnt_sb);
+		mutex_unlock(&sbinfo->si_xcache_mtx);
 
 		au_xino_lock_dir(sb, base_file, &ldir);
 		/* mnt_want_write() is unnecessary here */
@@ -921,6 +1164,10 @@ int au_xib_trunc(struct super_block *sb)
 		goto out;
 	}
 
+	err = au_xcache_flush(sb, /*h_sb*/NULL);
+	if (unlikely(err))
+		goto out;
+
 	mutex_lock(&sbinfo->si_xib_mtx);
 	/* mnt_want_write() is unnecessary here */
 	err = xib_restore(sb);
@@ -1061,6 +1308,11 @@ static int au_xino_set_br(struct super_block *sb, struct file *base)
 
 	SiMustWriteLock(sb);
 
+	/* the new xino files are copied from the current ones */
+	err = au_xcache_flush(sb, /*h_sb*/NULL);
+	if (unlikely(err))
+		goto out;
+
 	err = -ENOMEM;
 	bend = au_sbend(sb);
 	fpair = kcalloc(bend + 1, sizeof(*fpair), GFP_NOFS);
@@ -1123,6 +1375,9 @@ void au_xino_clr(struct super_block *sb)
 	xino_clear_xib(sb);
 	xino_clear_br(sb);
 	sbinfo = au_sbi(sb);
+	mutex_lock(&sbinfo->si_xcache_mtx);
+	xcache_drop(sbinfo, /*h_sb*/NULL);
+	mutex_unlock(&sbinfo->si_xcache_mtx);
 	/* lvalue, do not call au_mntflags() */
 	au_opt_clr(sbinfo->si_mntflags, XINO);
 }
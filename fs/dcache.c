@@ -38,6 +38,17 @@
 int sysctl_vfs_cache_pressure __read_mostly = 100;
 EXPORT_SYMBOL_GPL(sysctl_vfs_cache_pressure);
 
+/*
+ * Unused negative dentries survive memory pressure pruning for as long as
+ * there are no more than this many of them.  They pin no inode, and each
+ * one saves a trip into the filesystem when a missing name is looked up
+ * again.  Past the limit they lose their second chance on the LRU.
+ */
+int sysctl_negative_dentry_retain __read_mostly = 1024;
+
+/* # of negative dentries on all the LRUs, protected by dcache_lock */
+static int nr_dentry_negative;
+
  __cacheline_aligned_in_smp DEFINE_SPINLOCK(dcache_lock);
 __cacheline_aligned_in_smp DEFINE_SEQLOCK(rename_lock);
 
@@ -96,6 +107,23 @@ static void d_free(struct dentry *dentry)
 		call_rcu(&dentry->d_u.d_rcu, d_callback);
 }
 
+/*
+ * Negative dentries on the LRU are counted, so the count has to follow a
+ * dentry that changes state while it sits there.  Must be called with
+ * dcache_lock held.
+ */
+static void dentry_negative_inc(struct dentry *dentry)
+{
+	dentry->d_sb->s_nr_dentry_negative++;
+	nr_dentry_negative++;
+}
+
+static void dentry_negative_dec(struct dentry *dentry)
+{
+	dentry->d_sb->s_nr_dentry_negative--;
+	nr_dentry_negative--;
+}
+
 /*
  * Release the dentry's inode, using the filesystem
  * d_iput() operation if defined.
@@ -108,6 +136,8 @@ static void dentry_iput(struct dentry * dentry)
 	if (inode) {
 		dentry->d_inode = NULL;
 		list_del_init(&dentry->d_alias);
+		if (!list_empty(&dentry->d_lru))
+			dentry_negative_inc(dentry);
 		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
 		if (!inode->i_nlink)
@@ -130,6 +160,8 @@ static void dentry_lru_add(struct dentry *dentry)
 	list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
 	dentry->d_sb->s_nr_dentry_unused++;
 	dentry_stat.nr_unused++;
+	if (!dentry->d_inode)
+		dentry_negative_inc(dentry);
 }
 
 static void dentry_lru_add_tail(struct dentry *dentry)
@@ -137,6 +169,8 @@ static void dentry_lru_add_tail(struct dentry *dentry)
 	list_add_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
 	dentry->d_sb->s_nr_dentry_unused++;
 	dentry_stat.nr_unused++;
+	if (!dentry->d_inode)
+		dentry_negative_inc(dentry);
 }
 
 static void dentry_lru_del(struct dentry *dentry)
@@ -145,6 +179,8 @@ static void dentry_lru_del(struct dentry *dentry)
 		list_del(&dentry->d_lru);
 		dentry->d_sb->s_nr_dentry_unused--;
 		dentry_stat.nr_unused--;
+		if (!dentry->d_inode)
+			dentry_negative_dec(dentry);
 	}
 }
 
@@ -154,6 +190,8 @@ static void dentry_lru_del_init(struct dentry *dentry)
 		list_del_init(&dentry->d_lru);
 		dentry->d_sb->s_nr_dentry_unused--;
 		dentry_stat.nr_unused--;
+		if (!dentry->d_inode)
+			dentry_negative_dec(dentry);
 	}
 }
 
@@ -462,6 +500,7 @@ static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
 	LIST_HEAD(tmp);
 	struct dentry *dentry;
 	int cnt = 0;
+	int neg_excess;
 
 	BUG_ON(!sb);
 	BUG_ON((flags & DCACHE_REFERENCED) && count == NULL);
@@ -473,7 +512,11 @@ restart:
 	if (count == NULL)
 		list_splice_init(&sb->s_dentry_lru, &tmp);
 	else {
+		neg_excess = nr_dentry_negative -
+				sysctl_negative_dentry_retain;
 		while (!list_empty(&sb->s_dentry_lru)) {
+			int keep;
+
 			dentry = list_entry(sb->s_dentry_lru.prev,
 					struct dentry, d_lru);
 			BUG_ON(dentry->d_sb != sb);
@@ -483,9 +526,14 @@ restart:
 			 * If we are honouring the DCACHE_REFERENCED flag and
 			 * the dentry has this flag set, don't free it. Clear
 			 * the flag and put it back on the LRU.
+			 *
+			 * Negative dentries are kept whether referenced or
+			 * not, unless there are more of them than we retain.
 			 */
-			if ((flags & DCACHE_REFERENCED)
-				&& (dentry->d_flags & DCACHE_REFERENCED)) {
+			keep = dentry->d_flags & DCACHE_REFERENCED;
+			if (!dentry->d_inode)
+				keep = neg_excess-- <= 0;
+			if ((flags & DCACHE_REFERENCED) && keep) {
 				dentry->d_flags &= ~DCACHE_REFERENCED;
 				list_move(&dentry->d_lru, &referenced);
 				spin_unlock(&dentry->d_lock);
@@ -898,12 +946,17 @@ EXPORT_SYMBOL(shrink_dcache_parent);
  */
 static int shrink_dcache_memory(struct shrinker *shrink, int nr, gfp_t gfp_mask)
 {
+	int unused;
+
 	if (nr) {
 		if (!(gfp_mask & __GFP_FS))
 			return -1;
 		prune_dcache(nr);
 	}
-	return (dentry_stat.nr_unused / 100) * sysctl_vfs_cache_pressure;
+	/* Don't ask to be called for the negative dentries we retain */
+	unused = dentry_stat.nr_unused -
+		min(nr_dentry_negative, sysctl_negative_dentry_retain);
+	return (max(unused, 0) / 100) * sysctl_vfs_cache_pressure;
 }
 
 static struct shrinker dcache_shrinker = {
@@ -991,8 +1044,11 @@ EXPORT_SYMBOL(d_alloc_name);
 /* the caller must hold dcache_lock */
 static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 {
-	if (inode)
+	if (inode) {
 		list_add(&dentry->d_alias, &inode->i_dentry);
+		if (!list_empty(&dentry->d_lru))
+			dentry_negative_dec(dentry);
+	}
 	dentry->d_inode = inode;
 	fsnotify_d_instantiate(dentry, inode);
 }
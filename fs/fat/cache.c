@@ -13,11 +13,18 @@
 #include <linux/buffer_head.h>
 #include "fat.h"
 
+/*
+ * Each cache is an extent of contiguous clusters. They are indexed by the
+ * cluster number in the file, so that the nearest extent is found in
+ * O(log n), and the number per inode is bounded by recycling the least
+ * recently used one. A fragmented file caches every run it walks over.
+ */
 /* this must be > 0. */
-#define FAT_MAX_CACHE	8
+#define FAT_MAX_CACHE	512
 
 struct fat_cache {
 	struct list_head cache_list;
+	struct rb_node cache_node;
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
@@ -42,6 +49,7 @@ static void init_once(void *foo)
 	struct fat_cache *cache = (struct fat_cache *)foo;
 
 	INIT_LIST_HEAD(&cache->cache_list);
+	RB_CLEAR_NODE(&cache->cache_node);
 }
 
 int __init fat_cache_init(void)
@@ -78,29 +86,42 @@ static inline void fat_cache_update_lru(struct inode *inode,
 		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
 }
 
+/* Find the cache of "fclus" or the nearest one before it. */
+static struct fat_cache *fat_cache_find(struct inode *inode, int fclus)
+{
+	struct rb_node *n = MSDOS_I(inode)->cache_tree.rb_node;
+	struct fat_cache *p, *hit = NULL;
+
+	while (n) {
+		p = rb_entry(n, struct fat_cache, cache_node);
+		if (fclus < p->fcluster)
+			n = n->rb_left;
+		else {
+			hit = p;
+			if (fclus == p->fcluster)
+				break;
+			n = n->rb_right;
+		}
+	}
+	return hit;
+}
+
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct fat_cache *hit;
 	int offset = -1;
 
 	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
-			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
-		}
-	}
-	if (hit != &nohit) {
+	hit = fat_cache_find(inode, fclus);
+	/* fcluster 0 is never cached, i_start is the same */
+	if (hit && hit->fcluster > 0) {
+		if ((hit->fcluster + hit->nr_contig) < fclus)
+			offset = hit->nr_contig;
+		else
+			offset = fclus - hit->fcluster;
+
 		fat_cache_update_lru(inode, hit);
 
 		cid->id = MSDOS_I(inode)->cache_valid_id;
@@ -120,18 +141,35 @@ static struct fat_cache *fat_cache_merge(struct inode *inode,
 {
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			BUG_ON(p->dcluster != new->dcluster);
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
+	/* Find the same part as "new" in cluster-chain. */
+	p = fat_cache_find(inode, new->fcluster);
+	if (p && p->fcluster == new->fcluster) {
+		BUG_ON(p->dcluster != new->dcluster);
+		if (new->nr_contig > p->nr_contig)
+			p->nr_contig = new->nr_contig;
+		return p;
 	}
 	return NULL;
 }
 
+static void fat_cache_insert(struct inode *inode, struct fat_cache *cache)
+{
+	struct rb_root *root = &MSDOS_I(inode)->cache_tree;
+	struct rb_node **n = &root->rb_node, *parent = NULL;
+	struct fat_cache *p;
+
+	while (*n) {
+		parent = *n;
+		p = rb_entry(parent, struct fat_cache, cache_node);
+		if (cache->fcluster < p->fcluster)
+			n = &parent->rb_left;
+		else
+			n = &parent->rb_right;
+	}
+	rb_link_node(&cache->cache_node, parent, n);
+	rb_insert_color(&cache->cache_node, root);
+}
+
 static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 {
 	struct fat_cache *cache, *tmp;
@@ -147,25 +185,39 @@ static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 	cache = fat_cache_merge(inode, new);
 	if (cache == NULL) {
 		if (MSDOS_I(inode)->nr_caches < fat_max_cache(inode)) {
+			unsigned int id = MSDOS_I(inode)->cache_valid_id;
+
 			MSDOS_I(inode)->nr_caches++;
 			spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
 
 			tmp = fat_cache_alloc(inode);
 			spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+			if (id != MSDOS_I(inode)->cache_valid_id) {
+				/* invalidated while unlocked */
+				MSDOS_I(inode)->nr_caches--;
+				if (tmp)
+					fat_cache_free(tmp);
+				goto out;
+			}
 			cache = fat_cache_merge(inode, new);
-			if (cache != NULL) {
+			if (cache != NULL || tmp == NULL) {
 				MSDOS_I(inode)->nr_caches--;
-				fat_cache_free(tmp);
+				if (tmp)
+					fat_cache_free(tmp);
+				if (cache == NULL)
+					goto out;
 				goto out_update_lru;
 			}
 			cache = tmp;
 		} else {
 			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
 			cache = list_entry(p, struct fat_cache, cache_list);
+			rb_erase(&cache->cache_node, &MSDOS_I(inode)->cache_tree);
 		}
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		fat_cache_insert(inode, cache);
 	}
 out_update_lru:
 	fat_cache_update_lru(inode, cache);
@@ -185,6 +237,8 @@ static void __fat_cache_inval_inode(struct inode *inode)
 	while (!list_empty(&i->cache_lru)) {
 		cache = list_entry(i->cache_lru.next, struct fat_cache, cache_list);
 		list_del_init(&cache->cache_list);
+		rb_erase(&cache->cache_node, &i->cache_tree);
+		RB_CLEAR_NODE(&cache->cache_node);
 		i->nr_caches--;
 		fat_cache_free(cache);
 	}
@@ -265,8 +319,12 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* cache the run we just walked over */
+			cid.nr_contig--;
+			fat_cache_add(inode, &cid);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
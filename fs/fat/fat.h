@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/mutex.h>
 #include <linux/ratelimit.h>
+#include <linux/rbtree.h>
+#include <linux/workqueue.h>
 #include <linux/msdos_fs.h>
 
 /*
@@ -49,6 +51,13 @@ struct fat_mount_options {
 		 discard:1;	  /* Issue discard requests on deletions */
 };
 
+/* states of the free cluster bitmap */
+#define FAT_FREE_MAP_NONE	0	/* not built yet */
+#define FAT_FREE_MAP_ALLOC	1	/* queued, bitmap not allocated yet */
+#define FAT_FREE_MAP_BUILD	2	/* being built in the background */
+#define FAT_FREE_MAP_VALID	3	/* in sync with the FAT */
+#define FAT_FREE_MAP_FAIL	4	/* couldn't be built, don't retry */
+
 #define FAT_HASH_BITS	8
 #define FAT_HASH_SIZE	(1UL << FAT_HASH_BITS)
 
@@ -72,6 +81,9 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	unsigned long *free_map;     /* bitmap of free clusters, or NULL */
+	int free_map_state;          /* FAT_FREE_MAP_*, under fat_lock */
+	struct work_struct free_map_work;
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;  /* Codepage used on disk */
 	struct nls_table *nls_io;    /* Charset used for input and display */
@@ -98,6 +110,7 @@ struct msdos_sb_info {
 struct msdos_inode_info {
 	spinlock_t cache_lru_lock;
 	struct list_head cache_lru;
+	struct rb_root cache_tree;	/* caches by fcluster */
 	int nr_caches;
 	/* for avoiding the race between fat_free() and fat_get_cluster() */
 	unsigned int cache_valid_id;
@@ -105,6 +118,7 @@ struct msdos_inode_info {
 	/* NOTE: mmu_private is 64bits, so must hold ->i_mutex to access */
 	loff_t mmu_private;	/* physically allocated size */
 
+	int i_alloc_hint;	/* last allocated cluster or 0 */
 	int i_start;		/* first cluster or 0 */
 	int i_logstart;		/* logical first cluster */
 	int i_attrs;		/* unused attribute bits */
@@ -300,6 +314,10 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_free_map_queue(struct super_block *sb);
+extern void fat_free_map_release(struct super_block *sb);
+extern int fat_free_map_init(void);
+extern void fat_free_map_destroy(void);
 
 /* fat/file.c */
 extern long fat_generic_ioctl(struct file *filp, unsigned int cmd,
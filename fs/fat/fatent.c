@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -286,11 +287,16 @@ static inline void unlock_fat(struct msdos_sb_info *sbi)
 	mutex_unlock(&sbi->fat_lock);
 }
 
+static void fat_free_map_build(struct work_struct *work);
+
 void fat_ent_access_init(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 
 	mutex_init(&sbi->fat_lock);
+	sbi->free_map = NULL;
+	sbi->free_map_state = FAT_FREE_MAP_NONE;
+	INIT_WORK(&sbi->free_map_work, fat_free_map_build);
 
 	switch (sbi->fat_bits) {
 	case 32:
@@ -452,6 +458,257 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/* 128kb is the whole sectors for FAT12 and FAT16 */
+#define FAT_READA_SIZE		(128 * 1024)
+
+static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
+			  unsigned long reada_blocks)
+{
+	struct fatent_operations *ops = MSDOS_SB(sb)->fatent_ops;
+	sector_t blocknr;
+	int i, offset;
+
+	ops->ent_blocknr(sb, fatent->entry, &offset, &blocknr);
+
+	for (i = 0; i < reada_blocks; i++)
+		sb_breadahead(sb, blocknr + i);
+}
+
+/*
+ * In-memory bitmap of the free clusters.
+ *
+ * It is built after mount (or when the first cluster is allocated, should
+ * that come first), by a background scan
+ * which takes fat_lock for one FAT block at a time. Allocating and freeing
+ * always update the bits under fat_lock as well, so the blocks scanned so
+ * far stay in sync and the bitmap is exact once the scan completes. From
+ * then on the allocator finds free clusters in the bitmap instead of
+ * walking the FAT, and the free cluster count is known.
+ */
+#define FAT_ALLOC_RUN	16	/* clusters, wanted for a growing file */
+
+static struct workqueue_struct *fat_free_map_wq;
+
+static inline void fat_free_map_update(struct msdos_sb_info *sbi, int entry,
+				       int free)
+{
+	if (sbi->free_map_state != FAT_FREE_MAP_BUILD &&
+	    sbi->free_map_state != FAT_FREE_MAP_VALID)
+		return;
+	if (free)
+		__set_bit(entry, sbi->free_map);
+	else
+		__clear_bit(entry, sbi->free_map);
+}
+
+/* Must be called with fat_lock held, the bitmap is allocated by the worker */
+static void fat_free_map_start(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	sbi->free_map_state = FAT_FREE_MAP_ALLOC;
+	queue_work(fat_free_map_wq, &sbi->free_map_work);
+}
+
+/* vmalloc() may sleep for long, so it isn't done under fat_lock */
+static int fat_free_map_alloc(struct msdos_sb_info *sbi)
+{
+	unsigned long size = BITS_TO_LONGS(sbi->max_cluster) * sizeof(long);
+	unsigned long *map;
+
+	map = vmalloc(size);
+	if (map)
+		memset(map, 0, size);
+
+	lock_fat(sbi);
+	if (sbi->free_map_state != FAT_FREE_MAP_ALLOC) {
+		unlock_fat(sbi);
+		vfree(map);
+		return -EINTR;
+	}
+	if (!map) {
+		sbi->free_map_state = FAT_FREE_MAP_FAIL;
+		unlock_fat(sbi);
+		return -ENOMEM;
+	}
+	sbi->free_map = map;
+	sbi->free_map_state = FAT_FREE_MAP_BUILD;
+	unlock_fat(sbi);
+	return 0;
+}
+
+static void fat_free_map_build(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi =
+		container_of(work, struct msdos_sb_info, free_map_work);
+	struct super_block *sb = sbi->fat_inode->i_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+
+	if (fat_free_map_alloc(sbi))
+		return;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster) {
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		lock_fat(sbi);
+		if (sbi->free_map_state != FAT_FREE_MAP_BUILD)
+			goto out_unlock;
+		if (fat_ent_read_block(sb, &fatent)) {
+			sbi->free_map_state = FAT_FREE_MAP_FAIL;
+			goto out_unlock;
+		}
+		do {
+			fat_free_map_update(sbi, fatent.entry,
+				ops->ent_get(&fatent) == FAT_ENT_FREE);
+		} while (fat_ent_next(sbi, &fatent));
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+
+	lock_fat(sbi);
+	if (sbi->free_map_state == FAT_FREE_MAP_BUILD) {
+		sbi->free_clusters = bitmap_weight(sbi->free_map,
+						   sbi->max_cluster);
+		sbi->free_clus_valid = 1;
+		sbi->free_map_state = FAT_FREE_MAP_VALID;
+		sb->s_dirt = 1;
+	}
+out_unlock:
+	unlock_fat(sbi);
+	fatent_brelse(&fatent);
+}
+
+/* Queue the bitmap build, at mount */
+void fat_free_map_queue(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	lock_fat(sbi);
+	if (sbi->free_map_state == FAT_FREE_MAP_NONE)
+		fat_free_map_start(sb);
+	unlock_fat(sbi);
+}
+
+/* Stop the scan and free the bitmap, on unmount */
+void fat_free_map_release(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	lock_fat(sbi);
+	if (sbi->free_map_state == FAT_FREE_MAP_ALLOC ||
+	    sbi->free_map_state == FAT_FREE_MAP_BUILD)
+		sbi->free_map_state = FAT_FREE_MAP_FAIL;
+	unlock_fat(sbi);
+
+	cancel_work_sync(&sbi->free_map_work);
+	vfree(sbi->free_map);
+	sbi->free_map = NULL;
+}
+
+int __init fat_free_map_init(void)
+{
+	fat_free_map_wq = create_singlethread_workqueue("fat_free_map");
+	if (!fat_free_map_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void fat_free_map_destroy(void)
+{
+	destroy_workqueue(fat_free_map_wq);
+}
+
+/* The first free cluster in [from, to), or @to if there is none */
+static unsigned long fat_find_free_in(struct msdos_sb_info *sbi,
+				      unsigned long from, unsigned long to,
+				      int run)
+{
+	unsigned long entry, end;
+
+	entry = find_next_bit(sbi->free_map, to, from);
+	while (run > 1 && entry < to) {
+		end = find_next_zero_bit(sbi->free_map, to, entry);
+		if (end - entry >= run)
+			break;
+		entry = find_next_bit(sbi->free_map, to, end);
+	}
+	return entry;
+}
+
+/*
+ * Find a free cluster from @start, wrapping around at the end of the FAT.
+ * If @run is more than 1, the start of that many free clusters is preferred.
+ */
+static int fat_find_free(struct msdos_sb_info *sbi, int start, int run)
+{
+	unsigned long max = sbi->max_cluster, entry;
+
+	if (start < FAT_START_ENT || start >= max)
+		start = FAT_START_ENT;
+
+	entry = fat_find_free_in(sbi, start, max, run);
+	if (entry < max)
+		return entry;
+	entry = fat_find_free_in(sbi, FAT_START_ENT, start, run);
+	if (entry < start)
+		return entry;
+
+	/* No run that long, any free cluster will do */
+	if (run > 1)
+		return fat_find_free(sbi, start, 1);
+	return -1;
+}
+
+/* Pick the cluster to allocate next for @inode from the bitmap */
+static int fat_pick_free(struct inode *inode, int hint)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+
+	if (!hint)
+		return fat_find_free(sbi, sbi->prev_free + 1, 1);
+	/* keep the file contiguous, or move it to a run of free clusters */
+	if (hint + 1 < sbi->max_cluster && test_bit(hint + 1, sbi->free_map))
+		return hint + 1;
+	return fat_find_free(sbi, hint + 1, FAT_ALLOC_RUN);
+}
+
+/* Turn the free entry @fatent into the new end of the chain */
+static void fat_take_free_ent(struct super_block *sb, struct fat_entry *fatent,
+			      struct fat_entry *prev_ent,
+			      struct buffer_head **bhs, int *nr_bhs)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	int entry = fatent->entry;
+
+	/* make the cluster chain */
+	ops->ent_put(fatent, FAT_ENT_EOF);
+	if (prev_ent->nr_bhs)
+		ops->ent_put(prev_ent, entry);
+
+	fat_collect_bhs(bhs, nr_bhs, fatent);
+
+	sbi->prev_free = entry;
+	if (sbi->free_clusters != -1)
+		sbi->free_clusters--;
+	fat_free_map_update(sbi, entry, 0);
+	sb->s_dirt = 1;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -459,7 +716,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	struct fatent_operations *ops = sbi->fatent_ops;
 	struct fat_entry fatent, prev_ent;
 	struct buffer_head *bhs[MAX_BUF_PER_PAGE];
-	int i, count, err, nr_bhs, idx_clus;
+	int i, count, err, nr_bhs, idx_clus, hint;
 
 	BUG_ON(nr_cluster > (MAX_BUF_PER_PAGE / 2));	/* fixed limit */
 
@@ -469,12 +726,43 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		unlock_fat(sbi);
 		return -ENOSPC;
 	}
+	if (sbi->free_map_state == FAT_FREE_MAP_NONE)
+		fat_free_map_start(sb);
 
 	err = nr_bhs = idx_clus = 0;
-	count = FAT_START_ENT;
+	hint = MSDOS_I(inode)->i_alloc_hint;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
-	fatent_set_entry(&fatent, sbi->prev_free + 1);
+
+	if (sbi->free_map_state == FAT_FREE_MAP_VALID) {
+		while (1) {
+			int entry = fat_pick_free(inode, hint);
+			if (entry < 0)
+				break;
+
+			fatent_set_entry(&fatent, entry);
+			err = fat_ent_read_block(sb, &fatent);
+			if (err)
+				goto out;
+			if (ops->ent_get(&fatent) != FAT_ENT_FREE) {
+				/* The FAT is the authority, fix the bitmap */
+				fat_free_map_update(sbi, entry, 0);
+				continue;
+			}
+
+			fat_take_free_ent(sb, &fatent, &prev_ent, bhs, &nr_bhs);
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			hint = entry;
+			if (idx_clus == nr_cluster)
+				goto out;
+			prev_ent = fatent;
+		}
+		goto out_nospc;
+	}
+
+	count = FAT_START_ENT;
+	fatent_set_entry(&fatent, (hint ? hint : sbi->prev_free) + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
 			fatent.entry = FAT_START_ENT;
@@ -488,20 +776,12 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
 				int entry = fatent.entry;
 
-				/* make the cluster chain */
-				ops->ent_put(&fatent, FAT_ENT_EOF);
-				if (prev_ent.nr_bhs)
-					ops->ent_put(&prev_ent, entry);
-
-				fat_collect_bhs(bhs, &nr_bhs, &fatent);
-
-				sbi->prev_free = entry;
-				if (sbi->free_clusters != -1)
-					sbi->free_clusters--;
-				sb->s_dirt = 1;
+				fat_take_free_ent(sb, &fatent, &prev_ent,
+						  bhs, &nr_bhs);
 
 				cluster[idx_clus] = entry;
 				idx_clus++;
+				hint = entry;
 				if (idx_clus == nr_cluster)
 					goto out;
 
@@ -517,6 +797,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+out_nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -524,6 +805,8 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	err = -ENOSPC;
 
 out:
+	if (!err)
+		MSDOS_I(inode)->i_alloc_hint = hint;
 	unlock_fat(sbi);
 	fatent_brelse(&fatent);
 	if (!err) {
@@ -584,6 +867,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_update(sbi, fatent.entry, 1);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -622,22 +906,6 @@ error:
 
 EXPORT_SYMBOL_GPL(fat_free_clusters);
 
-/* 128kb is the whole sectors for FAT12 and FAT16 */
-#define FAT_READA_SIZE		(128 * 1024)
-
-static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
-			  unsigned long reada_blocks)
-{
-	struct fatent_operations *ops = MSDOS_SB(sb)->fatent_ops;
-	sector_t blocknr;
-	int i, offset;
-
-	ops->ent_blocknr(sb, fatent->entry, &offset, &blocknr);
-
-	for (i = 0; i < reada_blocks; i++)
-		sb_breadahead(sb, blocknr + i);
-}
-
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -650,6 +918,22 @@ int fat_count_free_clusters(struct super_block *sb)
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
 
+	/*
+	 * The bitmap scan counts the free clusters as well, so wait for it
+	 * rather than walk the FAT a second time. Walk it here only if the
+	 * bitmap couldn't be built.
+	 */
+	if (sbi->free_map_state == FAT_FREE_MAP_NONE)
+		fat_free_map_start(sb);
+	if (sbi->free_map_state == FAT_FREE_MAP_ALLOC ||
+	    sbi->free_map_state == FAT_FREE_MAP_BUILD) {
+		unlock_fat(sbi);
+		flush_work(&sbi->free_map_work);
+		lock_fat(sbi);
+		if (sbi->free_clusters != -1 && sbi->free_clus_valid)
+			goto out;
+	}
+
 	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
 	reada_mask = reada_blocks - 1;
 	cur_block = 0;
@@ -492,6 +492,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_free_map_release(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -517,6 +519,7 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 	ei = kmem_cache_alloc(fat_inode_cachep, GFP_NOFS);
 	if (!ei)
 		return NULL;
+	ei->i_alloc_hint = 0;
 	return &ei->vfs_inode;
 }
 
@@ -533,6 +536,7 @@ static void init_once(void *foo)
 	ei->nr_caches = 0;
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
 	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
 	INIT_HLIST_NODE(&ei->i_fat_hash);
 	inode_init_once(&ei->vfs_inode);
 }
@@ -567,7 +571,10 @@ static int fat_statfs(struct dentry *dentry, struct kstatfs *buf)
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 	u64 id = huge_encode_dev(sb->s_bdev->bd_dev);
 
-	/* If the count of free cluster is still unknown, counts it here. */
+	/*
+	 * The bitmap build queued at mount fills in the free count. If it
+	 * hasn't finished yet, this waits for it.
+	 */
 	if (sbi->free_clusters == -1 || !sbi->free_clus_valid) {
 		int err = fat_count_free_clusters(dentry->d_sb);
 		if (err)
@@ -1518,6 +1525,9 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	/* Have the free cluster count ready by the first statfs */
+	fat_free_map_queue(sb);
+
 	return 0;
 
 out_invalid:
@@ -1604,8 +1614,14 @@ static int __init init_fat_fs(void)
 	if (err)
 		goto failed;
 
+	err = fat_free_map_init();
+	if (err)
+		goto failed_inodecache;
+
 	return 0;
 
+failed_inodecache:
+	fat_destroy_inodecache();
 failed:
 	fat_cache_destroy();
 	return err;
@@ -1613,6 +1629,7 @@ failed:
 
 static void __exit exit_fat_fs(void)
 {
+	fat_free_map_destroy();
 	fat_cache_destroy();
 	fat_destroy_inodecache();
 }
@@ -1061,6 +1061,28 @@ static const struct pipe_buf_operations fuse_dev_pipe_buf_ops = {
 	.get = generic_pipe_buf_get,
 };
 
+/*
+ * Every request and reply spliced through the device needs a private
+ * array of pipe buffers.  Pipes of the default size are by far the most
+ * common, so use the caller's on-stack array for those and only allocate
+ * for pipes that were enlarged with F_SETPIPE_SZ.
+ */
+static struct pipe_buffer *fuse_get_pipebufs(struct pipe_inode_info *pipe,
+					     struct pipe_buffer *bufs_def)
+{
+	if (pipe->buffers <= PIPE_DEF_BUFFERS)
+		return bufs_def;
+
+	return kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
+}
+
+static void fuse_put_pipebufs(struct pipe_buffer *bufs,
+			      struct pipe_buffer *bufs_def)
+{
+	if (bufs != bufs_def)
+		kfree(bufs);
+}
+
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 				    struct pipe_inode_info *pipe,
 				    size_t len, unsigned int flags)
@@ -1068,13 +1090,13 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int ret;
 	int page_nr = 0;
 	int do_wakeup = 0;
-	struct pipe_buffer *bufs;
+	struct pipe_buffer *bufs, bufs_def[PIPE_DEF_BUFFERS];
 	struct fuse_copy_state cs;
 	struct fuse_conn *fc = fuse_get_conn(in);
 	if (!fc)
 		return -EPERM;
 
-	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
+	bufs = fuse_get_pipebufs(pipe, bufs_def);
 	if (!bufs)
 		return -ENOMEM;
 
@@ -1131,7 +1153,7 @@ out:
 	for (; page_nr < cs.nr_segs; page_nr++)
 		page_cache_release(bufs[page_nr].page);
 
-	kfree(bufs);
+	fuse_put_pipebufs(bufs, bufs_def);
 	return ret;
 }
 
@@ -1406,7 +1428,7 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 {
 	unsigned nbuf;
 	unsigned idx;
-	struct pipe_buffer *bufs;
+	struct pipe_buffer *bufs, bufs_def[PIPE_DEF_BUFFERS];
 	struct fuse_copy_state cs;
 	struct fuse_conn *fc;
 	size_t rem;
@@ -1416,7 +1438,7 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	if (!fc)
 		return -EPERM;
 
-	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
+	bufs = fuse_get_pipebufs(pipe, bufs_def);
 	if (!bufs)
 		return -ENOMEM;
 
@@ -1474,7 +1496,7 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 		buf->ops->release(pipe, buf);
 	}
 out:
-	kfree(bufs);
+	fuse_put_pipebufs(bufs, bufs_def);
 	return ret;
 }
 
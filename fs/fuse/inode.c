@@ -870,7 +870,12 @@ static int fuse_bdi_init(struct fuse_conn *fc, struct super_block *sb)
 	int err;
 
 	fc->bdi.name = "fuse";
-	fc->bdi.ra_pages = (VM_MAX_READAHEAD * 1024) / PAGE_CACHE_SIZE;
+	/*
+	 * Every round trip to the daemon is costly, so let a readahead
+	 * window fill a whole FUSE_READ request.
+	 */
+	fc->bdi.ra_pages = max_t(unsigned long, FUSE_MAX_PAGES_PER_REQ,
+				 (VM_MAX_READAHEAD * 1024) / PAGE_CACHE_SIZE);
 	fc->bdi.unplug_io_fn = default_unplug_io_fn;
 	/* fuse does it's own writeback accounting */
 	fc->bdi.capabilities = BDI_CAP_NO_ACCT_WB;
@@ -696,6 +696,23 @@ static __always_inline void follow_dotdot(struct nameidata *nd)
  *  small and for now I'd prefer to have fast path as straight as possible.
  *  It _is_ time-critical.
  */
+/*
+ * Per-superblock lookup statistics, shown in /proc/<pid>/mountstats.
+ * These are only approximate, nothing serialises the updates.
+ */
+static inline void lookup_stat_hit(struct dentry *dentry)
+{
+	if (dentry->d_inode)
+		dentry->d_sb->s_lookup_hits++;
+	else
+		dentry->d_sb->s_lookup_neg_hits++;
+}
+
+static inline void lookup_stat_miss(struct inode *dir)
+{
+	dir->i_sb->s_lookup_misses++;
+}
+
 static int do_lookup(struct nameidata *nd, struct qstr *name,
 		     struct path *path)
 {
@@ -717,6 +734,7 @@ static int do_lookup(struct nameidata *nd, struct qstr *name,
 		goto need_lookup;
 	if (dentry->d_op && dentry->d_op->d_revalidate)
 		goto need_revalidate;
+	lookup_stat_hit(dentry);
 done:
 	path->mnt = mnt;
 	path->dentry = dentry;
@@ -754,6 +772,7 @@ need_lookup:
 		new = d_alloc(parent, name);
 		dentry = ERR_PTR(-ENOMEM);
 		if (new) {
+			lookup_stat_miss(dir);
 			dentry = dir->i_op->lookup(dir, new, nd);
 			if (dentry)
 				dput(new);
@@ -787,6 +806,7 @@ need_revalidate:
 		goto need_lookup;
 	if (IS_ERR(dentry))
 		goto fail;
+	lookup_stat_hit(dentry);
 	goto done;
 
 fail:
@@ -1151,6 +1171,9 @@ static struct dentry *__lookup_hash(struct qstr *name,
 	if (dentry && dentry->d_op && dentry->d_op->d_revalidate)
 		dentry = do_revalidate(dentry, nd);
 
+	if (dentry && !IS_ERR(dentry))
+		lookup_stat_hit(dentry);
+
 	if (!dentry) {
 		struct dentry *new;
 
@@ -1163,6 +1186,7 @@ static struct dentry *__lookup_hash(struct qstr *name,
 		dentry = ERR_PTR(-ENOMEM);
 		if (!new)
 			goto out;
+		lookup_stat_miss(inode);
 		dentry = inode->i_op->lookup(inode, new, nd);
 		if (!dentry)
 			dentry = new;
@@ -894,6 +894,13 @@ const struct seq_operations mountinfo_op = {
 	.show	= show_mountinfo,
 };
 
+static void show_lookup_stats(struct seq_file *m, struct super_block *sb)
+{
+	seq_printf(m, " lookups=%lu,%lu,%lu negative=%d",
+		   sb->s_lookup_hits, sb->s_lookup_neg_hits,
+		   sb->s_lookup_misses, sb->s_nr_dentry_negative);
+}
+
 static int show_vfsstat(struct seq_file *m, void *v)
 {
 	struct vfsmount *mnt = list_entry(v, struct vfsmount, mnt_list);
@@ -916,11 +923,15 @@ static int show_vfsstat(struct seq_file *m, void *v)
 	seq_puts(m, "with fstype ");
 	show_type(m, mnt->mnt_sb);
 
-	/* optional statistics */
+	/*
+	 * optional statistics; filesystems that show their own keep their
+	 * format, tools parse it
+	 */
 	if (mnt->mnt_sb->s_op->show_stats) {
 		seq_putc(m, ' ');
 		err = mnt->mnt_sb->s_op->show_stats(m, mnt);
-	}
+	} else
+		show_lookup_stats(m, mnt->mnt_sb);
 
 	seq_putc(m, '\n');
 	return err;
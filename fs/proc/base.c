@@ -1293,6 +1293,57 @@ static const struct file_operations proc_pid_sched_operations = {
 
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Provides /proc/PID/sched_latency, writing to it clears the histogram
+ */
+static int sched_latency_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_latency_show(p, m);
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_latency_write(struct file *file, const char __user *buf,
+		    size_t count, loff_t *offset)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_latency_reset(p);
+
+	put_task_struct(p);
+
+	return count;
+}
+
+static int sched_latency_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_latency_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_latency_operations = {
+	.open		= sched_latency_open,
+	.read		= seq_read,
+	.write		= sched_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
 static ssize_t comm_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *offset)
 {
@@ -2612,6 +2663,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	INF("limits",	  S_IRUSR, proc_pid_limits),
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",      S_IRUGO|S_IWUSR, proc_pid_sched_operations),
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	REG("sched_latency", S_IRUGO|S_IWUSR, proc_pid_sched_latency_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
@@ -2952,6 +3006,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("limits",	 S_IRUSR, proc_pid_limits),
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",     S_IRUGO|S_IWUSR, proc_pid_sched_operations),
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	REG("sched_latency", S_IRUGO|S_IWUSR, proc_pid_sched_latency_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
@@ -390,6 +390,7 @@ __generic_file_splice_read(struct file *in, loff_t *ppos,
 		 */
 		this_len = min_t(unsigned long, len, PAGE_CACHE_SIZE - loff);
 		page = spd.pages[page_nr];
+		page_cache_ra_used(&in->f_ra, page);
 
 		if (PageReadahead(page))
 			page_cache_async_readahead(mapping, &in->f_ra, in,
@@ -26,30 +26,29 @@
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *);
 	void	(*free)(void *);
-	int	(*decompress)(struct squashfs_sb_info *, void **,
+	int	(*decompress)(struct squashfs_sb_info *, void *, void **,
 		struct buffer_head **, int, int, int, int, int);
 	int	id;
 	char	*name;
 	int	supported;
 };
 
-static inline void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+static inline void *squashfs_comp_init(struct squashfs_sb_info *msblk)
 {
 	return msblk->decompressor->init(msblk);
 }
 
-static inline void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
-	void *s)
+static inline void squashfs_comp_free(struct squashfs_sb_info *msblk,
+	void *strm)
 {
-	if (msblk->decompressor)
-		msblk->decompressor->free(s);
+	msblk->decompressor->free(strm);
 }
 
-static inline int squashfs_decompress(struct squashfs_sb_info *msblk,
-	void **buffer, struct buffer_head **bh, int b, int offset, int length,
-	int srclength, int pages)
+static inline int squashfs_comp_decompress(struct squashfs_sb_info *msblk,
+	void *strm, void **buffer, struct buffer_head **bh, int b, int offset,
+	int length, int srclength, int pages)
 {
-	return msblk->decompressor->decompress(msblk, buffer, bh, b, offset,
-		length, srclength, pages);
+	return msblk->decompressor->decompress(msblk, strm, buffer, bh, b,
+		offset, length, srclength, pages);
 }
 #endif
@@ -0,0 +1,173 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008, 2009
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * file_direct.c
+ */
+
+/*
+ * This file decompresses datablocks straight into the page cache pages
+ * they cover, rather than into the "data" read cache followed by a copy.
+ *
+ * All the pages of the block are grabbed and mapped up front, and the
+ * page addresses are handed to squashfs_read_data() as its output buffer.
+ * If any page can't be grabbed without blocking, or is already up to date
+ * (and so maybe mapped), the block goes through the read cache as before.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/mutex.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+static int squashfs_read_cache(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *i = target_page->mapping->host;
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
+		block, bsize);
+	int res = buffer->error;
+
+	if (res)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	else
+		squashfs_copy_cache(target_page, buffer, buffer->length, 0);
+
+	squashfs_cache_put(buffer);
+	return res;
+}
+
+
+/*
+ * Unlock and drop the pages grabbed for a block, except the page we were
+ * called to fill, which squashfs_readpage() owns.
+ */
+static void squashfs_release_pages(struct page *target_page,
+	struct page **page, int pages, int uptodate)
+{
+	int i;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+
+		flush_dcache_page(page[i]);
+		if (uptodate)
+			SetPageUptodate(page[i]);
+		if (page[i] == target_page) {
+			if (uptodate)
+				unlock_page(page[i]);
+			continue;
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+}
+
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, missing_pages = 0, res = -ENOMEM;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	/*
+	 * Grab the pages of the block.  The page we've been called to fill
+	 * is already locked.
+	 */
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	if (missing_pages) {
+		/*
+		 * Couldn't get all the pages, fall back to the read cache,
+		 * which fills whatever pages are there.
+		 */
+		squashfs_release_pages(target_page, page, pages, 0);
+		res = squashfs_read_cache(target_page, block, bsize);
+		goto out;
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	/* Zero the part of the block past the end of the data */
+	for (i = 0; res >= 0 && i < pages; i++) {
+		int avail = min_t(int, max(res - (i << PAGE_CACHE_SHIFT), 0),
+			PAGE_CACHE_SIZE);
+
+		memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+	}
+
+	for (i = 0; i < pages; i++)
+		kunmap(page[i]);
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+
+	squashfs_release_pages(target_page, page, pages, res >= 0);
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res < 0 ? res : 0;
+}
@@ -74,8 +74,50 @@ static struct ubifs_compressor zlib_compr = {
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
+/*
+ * File name extensions of formats which are compressed already. Files with
+ * these names are created with compression switched off, see
+ * 'ubifs_compr_skip_name()'.
+ */
+static const char * const compressed_exts[] = {
+	"7z", "aac", "apk", "bz2", "gif", "gz", "jar", "jpeg", "jpg", "lzma",
+	"lzo", "m4a", "mkv", "mp3", "mp4", "ogg", "png", "rar", "tgz", "webm",
+	"xz", "zip", NULL
+};
+
+/**
+ * ubifs_compr_skip_name - check if a file name suggests compressed contents.
+ * @nm: file name
+ *
+ * This function returns %1 if the extension of the file name @nm is one of a
+ * well-known compressed format, in which case there is no point in spending
+ * CPU time trying to compress the file data again. Otherwise it returns %0.
+ */
+int ubifs_compr_skip_name(const struct qstr *nm)
+{
+	const char *ext = NULL;
+	int i, len;
+
+	for (i = nm->len - 1; i > 0; i--)
+		if (nm->name[i] == '.') {
+			ext = nm->name + i + 1;
+			break;
+		}
+	if (!ext)
+		return 0;
+
+	len = nm->name + nm->len - (const unsigned char *)ext;
+	for (i = 0; compressed_exts[i]; i++)
+		if (strlen(compressed_exts[i]) == len &&
+		    !strnicmp(ext, compressed_exts[i], len))
+			return 1;
+
+	return 0;
+}
+
 /**
  * ubifs_compress - compress data.
+ * @c: UBIFS file-system description object
  * @in_buf: data to compress
  * @in_len: length of the data to compress
  * @out_buf: output buffer where compressed data should be stored
@@ -89,22 +131,31 @@ struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
  * @out_buf. The same happens if @compr_type is %UBIFS_COMPR_NONE or if
  * compression error occurred.
  *
+ * The data is also left uncompressed if it did not shrink by at least
+ * @c->compr_min_gain percent (the "compr_min_gain" mount option).
+ *
  * Note, if the input buffer was not compressed, it is copied to the output
  * buffer and %UBIFS_COMPR_NONE is returned in @compr_type.
  */
-void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
-		    int *compr_type)
+void ubifs_compress(struct ubifs_info *c, const void *in_buf, int in_len,
+		    void *out_buf, int *out_len, int *compr_type)
 {
 	int err;
 	struct ubifs_compressor *compr = ubifs_compressors[*compr_type];
+	ktime_t start;
 
 	if (*compr_type == UBIFS_COMPR_NONE)
 		goto no_compr;
 
+	/* The inode may ask for a compressor which was not compiled in */
+	if (unlikely(!compr->capi_name))
+		goto no_compr;
+
 	/* If the input data is small, do not even try to compress it */
 	if (in_len < UBIFS_MIN_COMPR_LEN)
 		goto no_compr;
 
+	start = dbg_compr_start();
 	if (compr->comp_mutex)
 		mutex_lock(compr->comp_mutex);
 	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
@@ -115,7 +166,7 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		ubifs_warn("cannot compress %d bytes, compressor %s, "
 			   "error %d, leave data uncompressed",
 			   in_len, compr->name, err);
-		 goto no_compr;
+		 goto rejected;
 	}
 
 	/*
@@ -123,10 +174,16 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 	 * uncompressed to improve read speed.
 	 */
 	if (in_len - *out_len < UBIFS_MIN_COMPRESS_DIFF)
-		goto no_compr;
+		goto rejected;
+
+	if ((in_len - *out_len) * 100 < in_len * c->compr_min_gain)
+		goto rejected;
 
+	dbg_compr_stat(c, *compr_type, in_len, *out_len, start);
 	return;
 
+rejected:
+	dbg_compr_stat(c, *compr_type, in_len, in_len, start);
 no_compr:
 	memcpy(out_buf, in_buf, in_len);
 	*out_len = in_len;
@@ -135,6 +192,7 @@ no_compr:
 
 /**
  * ubifs_decompress - decompress data.
+ * @c: UBIFS file-system description object
  * @in_buf: data to decompress
  * @in_len: length of the data to decompress
  * @out_buf: output buffer where decompressed data should
@@ -145,11 +203,12 @@ no_compr:
  * The length of the uncompressed data is returned in @out_len. This functions
  * returns %0 on success or a negative error code on failure.
  */
-int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
-		     int *out_len, int compr_type)
+int ubifs_decompress(struct ubifs_info *c, const void *in_buf, int in_len,
+		     void *out_buf, int *out_len, int compr_type)
 {
 	int err;
 	struct ubifs_compressor *compr;
+	ktime_t start;
 
 	if (unlikely(compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)) {
 		ubifs_err("invalid compression type %d", compr_type);
@@ -169,12 +228,14 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 		return 0;
 	}
 
+	start = dbg_compr_start();
 	if (compr->decomp_mutex)
 		mutex_lock(compr->decomp_mutex);
 	err = crypto_comp_decompress(compr->cc, in_buf, in_len, out_buf,
 				     (unsigned int *)out_len);
 	if (compr->decomp_mutex)
 		mutex_unlock(compr->decomp_mutex);
+	dbg_decompr_stat(c, compr_type, start);
 	if (err)
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
@@ -2551,6 +2551,50 @@ int dbg_leb_map(struct ubi_volume_desc *desc, int lnum, int dtype)
 	return 0;
 }
 
+/**
+ * dbg_compr_stat - account a compression.
+ * @c: UBIFS file-system description object
+ * @compr_type: compressor which was used
+ * @in_len: length of the data which were compressed
+ * @out_len: length of the data stored on the media, which is @in_len if the
+ *           compressed data were not used
+ * @start: time the compression started at, from 'dbg_compr_start()'
+ */
+void dbg_compr_stat(struct ubifs_info *c, int compr_type, int in_len,
+		    int out_len, ktime_t start)
+{
+	struct ubifs_debug_info *d = c->dbg;
+	struct ubifs_compr_stats *st = &d->compr_stats[compr_type];
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&d->compr_stats_lock);
+	st->compr_cnt += 1;
+	if (out_len >= in_len)
+		st->rejected_cnt += 1;
+	st->in_bytes += in_len;
+	st->out_bytes += out_len;
+	st->compr_ns += ns;
+	spin_unlock(&d->compr_stats_lock);
+}
+
+/**
+ * dbg_decompr_stat - account a decompression.
+ * @c: UBIFS file-system description object
+ * @compr_type: compressor which was used
+ * @start: time the decompression started at, from 'dbg_compr_start()'
+ */
+void dbg_decompr_stat(struct ubifs_info *c, int compr_type, ktime_t start)
+{
+	struct ubifs_debug_info *d = c->dbg;
+	struct ubifs_compr_stats *st = &d->compr_stats[compr_type];
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&d->compr_stats_lock);
+	st->decompr_cnt += 1;
+	st->decompr_ns += ns;
+	spin_unlock(&d->compr_stats_lock);
+}
+
 /**
  * ubifs_debugging_init - initialize UBIFS debugging.
  * @c: UBIFS file-system description object
@@ -2569,6 +2613,7 @@ int ubifs_debugging_init(struct ubifs_info *c)
 	if (!c->dbg->buf)
 		goto out;
 
+	spin_lock_init(&c->dbg->compr_stats_lock);
 	failure_mode_init(c);
 	return 0;
 
@@ -2658,6 +2703,54 @@ static const struct file_operations dfs_fops = {
 	.owner = THIS_MODULE,
 };
 
+static ssize_t read_compr_stats(struct file *file, char __user *u,
+				size_t count, loff_t *ppos)
+{
+	struct ubifs_info *c = file->private_data;
+	struct ubifs_debug_info *d = c->dbg;
+	struct ubifs_compr_stats stats[UBIFS_COMPR_TYPES_CNT];
+	char *buf;
+	int i, len = 0, size = 256 * UBIFS_COMPR_TYPES_CNT;
+	ssize_t ret;
+
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock(&d->compr_stats_lock);
+	memcpy(stats, d->compr_stats, sizeof(stats));
+	spin_unlock(&d->compr_stats_lock);
+
+	for (i = 0; i < UBIFS_COMPR_TYPES_CNT; i++) {
+		struct ubifs_compr_stats *st = &stats[i];
+
+		if (i == UBIFS_COMPR_NONE || !ubifs_compr_present(i))
+			continue;
+		len += scnprintf(buf + len, size - len,
+				 "%s:\n"
+				 "\tcompressed:   %llu (rejected %llu)\n"
+				 "\tbytes in:     %llu\n"
+				 "\tbytes out:    %llu\n"
+				 "\tcompr_ns:     %llu\n"
+				 "\tdecompressed: %llu\n"
+				 "\tdecompr_ns:   %llu\n",
+				 ubifs_compr_name(i), st->compr_cnt,
+				 st->rejected_cnt, st->in_bytes,
+				 st->out_bytes, st->compr_ns, st->decompr_cnt,
+				 st->decompr_ns);
+	}
+
+	ret = simple_read_from_buffer(u, count, ppos, buf, len);
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations dfs_compr_fops = {
+	.open = open_debugfs_file,
+	.read = read_compr_stats,
+	.owner = THIS_MODULE,
+};
+
 /**
  * dbg_debugfs_init_fs - initialize debugfs for UBIFS instance.
  * @c: UBIFS file-system description object
@@ -2704,6 +2797,13 @@ int dbg_debugfs_init_fs(struct ubifs_info *c)
 		goto out_remove;
 	d->dfs_dump_tnc = dent;
 
+	fname = "compr_stats";
+	dent = debugfs_create_file(fname, S_IRUSR, d->dfs_dir, c,
+				   &dfs_compr_fops);
+	if (IS_ERR(dent))
+		goto out_remove;
+	d->dfs_compr_stats = dent;
+
 	return 0;
 
 out_remove:
@@ -25,6 +25,27 @@
 
 #ifdef CONFIG_UBIFS_FS_DEBUG
 
+/**
+ * ubifs_compr_stats - per-compressor statistics.
+ * @compr_cnt: how many times data were compressed
+ * @rejected_cnt: how many of those were stored uncompressed anyway, because
+ *                compression failed or did not save enough space
+ * @in_bytes: how many bytes were given to the compressor
+ * @out_bytes: how many bytes were stored on the media as a result
+ * @compr_ns: time spent compressing, in nanoseconds
+ * @decompr_cnt: how many times data were decompressed
+ * @decompr_ns: time spent decompressing, in nanoseconds
+ */
+struct ubifs_compr_stats {
+	unsigned long long compr_cnt;
+	unsigned long long rejected_cnt;
+	unsigned long long in_bytes;
+	unsigned long long out_bytes;
+	unsigned long long compr_ns;
+	unsigned long long decompr_cnt;
+	unsigned long long decompr_ns;
+};
+
 /**
  * ubifs_debug_info - per-FS debugging information.
  * @buf: a buffer of LEB size, used for various purposes
@@ -47,11 +68,15 @@
  * @saved_lst: saved lprops statistics (used by 'dbg_save_space_info()')
  * @saved_free: saved free space (used by 'dbg_save_space_info()')
  *
+ * @compr_stats: compression statistics, indexed by compressor type
+ * @compr_stats_lock: protects @compr_stats
+ *
  * dfs_dir_name: name of debugfs directory containing this file-system's files
  * dfs_dir: direntry object of the file-system debugfs directory
  * dfs_dump_lprops: "dump lprops" debugfs knob
  * dfs_dump_budg: "dump budgeting information" debugfs knob
  * dfs_dump_tnc: "dump TNC" debugfs knob
+ * dfs_compr_stats: "compression statistics" debugfs file
  */
 struct ubifs_debug_info {
 	void *buf;
@@ -74,11 +99,15 @@ struct ubifs_debug_info {
 	struct ubifs_lp_stats saved_lst;
 	long long saved_free;
 
+	struct ubifs_compr_stats compr_stats[UBIFS_COMPR_TYPES_CNT];
+	spinlock_t compr_stats_lock;
+
 	char dfs_dir_name[100];
 	struct dentry *dfs_dir;
 	struct dentry *dfs_dump_lprops;
 	struct dentry *dfs_dump_budg;
 	struct dentry *dfs_dump_tnc;
+	struct dentry *dfs_compr_stats;
 };
 
 #define ubifs_assert(expr) do {                                                \
@@ -377,6 +406,16 @@ static inline int dbg_change(struct ubi_volume_desc *desc, int lnum,
 	return dbg_leb_change(desc, lnum, buf, len, UBI_UNKNOWN);
 }
 
+/* Compression statistics */
+static inline ktime_t dbg_compr_start(void)
+{
+	return ktime_get();
+}
+
+void dbg_compr_stat(struct ubifs_info *c, int compr_type, int in_len,
+		    int out_len, ktime_t start);
+void dbg_decompr_stat(struct ubifs_info *c, int compr_type, ktime_t start);
+
 /* Debugfs-related stuff */
 int dbg_debugfs_init(void);
 void dbg_debugfs_exit(void);
@@ -469,6 +508,16 @@ void dbg_debugfs_exit_fs(struct ubifs_info *c);
 #define dbg_force_in_the_gaps()                    0
 #define dbg_failure_mode                           0
 
+static inline ktime_t dbg_compr_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void dbg_compr_stat(struct ubifs_info *c, int compr_type,
+				  int in_len, int out_len, ktime_t start) {}
+static inline void dbg_decompr_stat(struct ubifs_info *c, int compr_type,
+				    ktime_t start) {}
+
 #define dbg_debugfs_init()                         0
 #define dbg_debugfs_exit()
 #define dbg_debugfs_init_fs(c)                     0
@@ -75,6 +75,33 @@ static int inherit_flags(const struct inode *dir, int mode)
 	return flags;
 }
 
+/**
+ * inherit_compr_type - inherit compression policy of the parent inode.
+ * @c: UBIFS file-system description object
+ * @dir: parent inode
+ * @mode: new inode mode flags
+ *
+ * This is a helper function for 'ubifs_new_inode()' which picks the
+ * compressor of a new inode. Directories do not contain data, so their
+ * compressor type is %UBIFS_COMPR_NONE unless a compression policy was set for
+ * them with the "user.ubifs.compr" extended attribute. New regular files and
+ * sub-directories inherit such a policy. Otherwise regular files use the
+ * default compressor.
+ */
+static int inherit_compr_type(const struct ubifs_info *c,
+			      const struct inode *dir, int mode)
+{
+	const struct ubifs_inode *ui = ubifs_inode(dir);
+
+	if (!S_ISREG(mode) && !S_ISDIR(mode))
+		return UBIFS_COMPR_NONE;
+
+	if (S_ISDIR(dir->i_mode) && ui->compr_type != UBIFS_COMPR_NONE)
+		return ui->compr_type;
+
+	return S_ISREG(mode) ? c->default_compr : UBIFS_COMPR_NONE;
+}
+
 /**
  * ubifs_new_inode - allocate new UBIFS inode object.
  * @c: UBIFS file-system description object
@@ -137,10 +164,7 @@ struct inode *ubifs_new_inode(struct ubifs_info *c, const struct inode *dir,
 
 	ui->flags = inherit_flags(dir, mode);
 	ubifs_set_inode_flags(inode);
-	if (S_ISREG(mode))
-		ui->compr_type = c->default_compr;
-	else
-		ui->compr_type = UBIFS_COMPR_NONE;
+	ui->compr_type = inherit_compr_type(c, dir, mode);
 	ui->synced_i_size = 0;
 
 	spin_lock(&c->cnt_lock);
@@ -279,6 +303,10 @@ static int ubifs_create(struct inode *dir, struct dentry *dentry, int mode,
 		goto out_budg;
 	}
 
+	if (ubifs_compr_skip_name(&dentry->d_name))
+		/* The data is compressed already, do not try again */
+		ubifs_inode(inode)->compr_type = UBIFS_COMPR_NONE;
+
 	mutex_lock(&dir_ui->ui_mutex);
 	dir->i_size += sz_change;
 	dir_ui->ui_size = dir->i_size;
@@ -432,6 +432,9 @@ static int ubifs_show_options(struct seq_file *s, struct vfsmount *mnt)
 			   ubifs_compr_name(c->mount_opts.compr_type));
 	}
 
+	if (c->compr_min_gain)
+		seq_printf(s, ",compr_min_gain=%d", c->compr_min_gain);
+
 	return 0;
 }
 
@@ -904,6 +907,8 @@ static int check_volume_empty(struct ubifs_info *c)
  * Opt_chk_data_crc: check CRCs when reading data nodes
  * Opt_no_chk_data_crc: do not check CRCs when reading data nodes
  * Opt_override_compr: override default compressor
+ * Opt_compr_min_gain: minimum space saving, in percent, to store data
+ *                     compressed
  * Opt_err: just end of array marker
  */
 enum {
@@ -914,6 +919,7 @@ enum {
 	Opt_chk_data_crc,
 	Opt_no_chk_data_crc,
 	Opt_override_compr,
+	Opt_compr_min_gain,
 	Opt_err,
 };
 
@@ -925,6 +931,7 @@ static const match_table_t tokens = {
 	{Opt_chk_data_crc, "chk_data_crc"},
 	{Opt_no_chk_data_crc, "no_chk_data_crc"},
 	{Opt_override_compr, "compr=%s"},
+	{Opt_compr_min_gain, "compr_min_gain=%d"},
 	{Opt_err, NULL},
 };
 
@@ -1024,6 +1031,19 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 			c->default_compr = c->mount_opts.compr_type;
 			break;
 		}
+		case Opt_compr_min_gain:
+		{
+			int gain;
+
+			if (match_int(&args[0], &gain) || gain < 0 ||
+			    gain > 99) {
+				ubifs_err("bad compr_min_gain value, must be "
+					  "a percentage from 0 to 99");
+				return -EINVAL;
+			}
+			c->compr_min_gain = gain;
+			break;
+		}
 		default:
 		{
 			unsigned long flag;
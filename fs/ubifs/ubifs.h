@@ -36,6 +36,7 @@
 #include <linux/mtd/ubi.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
+#include <linux/ktime.h>
 #include "ubifs-media.h"
 
 /* Version of this UBIFS implementation */
@@ -1174,6 +1175,8 @@ struct ubifs_debug_info;
  * @remounting_rw: set while remounting from ro to rw (sb flags have MS_RDONLY)
  * @always_chk_crc: always check CRCs (while mounting and remounting rw)
  * @mount_opts: UBIFS-specific mount options
+ * @compr_min_gain: minimum space saving, in percent, for data to be stored
+ *                  compressed
  *
  * @dbg: debugging-related information
  */
@@ -1405,6 +1408,7 @@ struct ubifs_info {
 	int remounting_rw;
 	int always_chk_crc;
 	struct ubifs_mount_opts mount_opts;
+	int compr_min_gain;
 
 #ifdef CONFIG_UBIFS_FS_DEBUG
 	struct ubifs_debug_info *dbg;
@@ -1723,10 +1727,11 @@ long ubifs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 /* compressor.c */
 int __init ubifs_compressors_init(void);
 void ubifs_compressors_exit(void);
-void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
-		    int *compr_type);
-int ubifs_decompress(const void *buf, int len, void *out, int *out_len,
-		     int compr_type);
+int ubifs_compr_skip_name(const struct qstr *nm);
+void ubifs_compress(struct ubifs_info *c, const void *in_buf, int in_len,
+		    void *out_buf, int *out_len, int *compr_type);
+int ubifs_decompress(struct ubifs_info *c, const void *buf, int len,
+		     void *out, int *out_len, int compr_type);
 
 #include "debug.h"
 #include "misc.h"
@@ -53,6 +53,10 @@
  * tnc.c).
  *
  * ACL support is not implemented.
+ *
+ * The "user.ubifs.compr" extended attribute is not stored on the media. It
+ * reads and sets the compressor of the inode instead, see
+ * 'set_compr_policy()'.
  */
 
 #include "ubifs.h"
@@ -79,6 +83,9 @@ enum {
 	SECURITY_XATTR,
 };
 
+/* Name of the extended attribute which selects the compressor of an inode */
+#define UBIFS_COMPR_XATTR "user.ubifs.compr"
+
 static const struct inode_operations none_inode_operations;
 static const struct address_space_operations none_address_operations;
 static const struct file_operations none_file_operations;
@@ -242,6 +249,121 @@ out_free:
 	return err;
 }
 
+/**
+ * set_compr_policy - set compressor of an inode.
+ * @c: UBIFS file-system description object
+ * @inode: the inode to change
+ * @dir: parent directory of @inode, or %NULL if it has none
+ * @value: compressor name ("none", "lzo" or "zlib"), not zero-terminated
+ * @size: length of @value
+ *
+ * This function changes the compressor used for data written to regular file
+ * @inode from now on. For a directory, it sets the compressor inherited by
+ * regular files and sub-directories created in it (see 'ubifs_new_inode()').
+ * Data already on the media is not re-compressed. If @value is %NULL, the
+ * policy is reset: regular files go back to the default compressor, and
+ * directories stop passing a compressor on. The compression flag is taken
+ * from @dir again, as 'inherit_flags()' does for a new inode, or set if there
+ * is no parent, as it is for the root directory. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+static int set_compr_policy(struct ubifs_info *c, struct inode *inode,
+			    const struct inode *dir, const void *value,
+			    size_t size)
+{
+	int compr_type, compr_fl, release, err;
+	struct ubifs_inode *ui = ubifs_inode(inode);
+	struct ubifs_budget_req req = { .dirtied_ino = 1,
+				.dirtied_ino_d = ALIGN(ui->data_len, 8) };
+
+	if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+		return -EOPNOTSUPP;
+
+	if (value) {
+		for (compr_type = 0; compr_type < UBIFS_COMPR_TYPES_CNT;
+		     compr_type++) {
+			const char *name = ubifs_compr_name(compr_type);
+
+			if (strlen(name) == size && !memcmp(name, value, size))
+				break;
+		}
+		if (compr_type == UBIFS_COMPR_TYPES_CNT)
+			return -EINVAL;
+		if (!ubifs_compr_present(compr_type))
+			return -EOPNOTSUPP;
+		compr_fl = compr_type == UBIFS_COMPR_NONE ? 0 : UBIFS_COMPR_FL;
+	} else {
+		if (S_ISREG(inode->i_mode))
+			compr_type = c->default_compr;
+		else
+			compr_type = UBIFS_COMPR_NONE;
+		if (dir)
+			compr_fl = ubifs_inode(dir)->flags & UBIFS_COMPR_FL;
+		else
+			compr_fl = UBIFS_COMPR_FL;
+	}
+
+	err = ubifs_budget_space(c, &req);
+	if (err)
+		return err;
+
+	mutex_lock(&ui->ui_mutex);
+	ui->compr_type = compr_type;
+	/* The compression flag is inherited, see 'inherit_flags()' */
+	ui->flags = (ui->flags & ~UBIFS_COMPR_FL) | compr_fl;
+	inode->i_ctime = ubifs_current_time(inode);
+	release = ui->dirty;
+	mark_inode_dirty_sync(inode);
+	mutex_unlock(&ui->ui_mutex);
+
+	if (release)
+		ubifs_release_budget(c, &req);
+	if (IS_SYNC(inode))
+		err = write_inode_now(inode, 1);
+	return err;
+}
+
+/**
+ * get_compr_policy - get compressor name of an inode.
+ * @inode: the inode to look at
+ * @buf: buffer to store the name in, or %NULL to only get its length
+ * @size: size of @buf
+ *
+ * This function returns the length of the compressor name in case of success,
+ * %-ENODATA if no compressor applies to @inode, and %-ERANGE if @buf is too
+ * small.
+ */
+static ssize_t get_compr_policy(struct inode *inode, void *buf, size_t size)
+{
+	struct ubifs_inode *ui = ubifs_inode(inode);
+	const char *name;
+	ssize_t len;
+
+	if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+		return -ENODATA;
+
+	mutex_lock(&ui->ui_mutex);
+	if (!(ui->flags & UBIFS_COMPR_FL))
+		name = ubifs_compr_name(UBIFS_COMPR_NONE);
+	else if (S_ISDIR(inode->i_mode) && ui->compr_type == UBIFS_COMPR_NONE)
+		/* The directory has no policy of its own */
+		name = NULL;
+	else
+		name = ubifs_compr_name(ui->compr_type);
+	mutex_unlock(&ui->ui_mutex);
+
+	if (!name)
+		return -ENODATA;
+
+	len = strlen(name);
+	if (buf) {
+		if (len > size)
+			return -ERANGE;
+		memcpy(buf, name, len);
+	}
+	return len;
+}
+
 /**
  * check_namespace - check extended attribute name-space.
  * @nm: extended attribute name
@@ -312,6 +434,9 @@ int ubifs_setxattr(struct dentry *dentry, const char *name,
 	if (size > UBIFS_MAX_INO_DATA)
 		return -ERANGE;
 
+	if (!strcmp(name, UBIFS_COMPR_XATTR))
+		return set_compr_policy(c, host, NULL, value, size);
+
 	type = check_namespace(&nm);
 	if (type < 0)
 		return type;
@@ -372,6 +497,9 @@ ssize_t ubifs_getxattr(struct dentry *dentry, const char *name, void *buf,
 	dbg_gen("xattr '%s', ino %lu ('%.*s'), buf size %zd", name,
 		host->i_ino, dentry->d_name.len, dentry->d_name.name, size);
 
+	if (!strcmp(name, UBIFS_COMPR_XATTR))
+		return get_compr_policy(host, buf, size);
+
 	err = check_namespace(&nm);
 	if (err < 0)
 		return err;
@@ -535,6 +663,16 @@ int ubifs_removexattr(struct dentry *dentry, const char *name)
 		host->i_ino, dentry->d_name.len, dentry->d_name.name);
 	ubifs_assert(mutex_is_locked(&host->i_mutex));
 
+	if (!strcmp(name, UBIFS_COMPR_XATTR)) {
+		struct dentry *parent = dget_parent(dentry);
+
+		err = set_compr_policy(c, host,
+				       parent != dentry ? parent->d_inode : NULL,
+				       NULL, 0);
+		dput(parent);
+		return err;
+	}
+
 	err = check_namespace(&nm);
 	if (err < 0)
 		return err;
@@ -26,6 +26,7 @@
 #include "yaffs_yaffs2.h"
 #include "yaffs_bitmap.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 #include "yaffs_nand.h"
 #include "yaffs_packedtags2.h"
@@ -37,6 +38,9 @@
 #define YAFFS_GC_GOOD_ENOUGH 2
 #define YAFFS_GC_PASSIVE_THRESHOLD 4
 
+/* Block age beyond which the cost-benefit gc score stops growing */
+#define YAFFS_GC_MAX_AGE	0x100000
+
 #include "yaffs_ecc.h"
 
 
@@ -298,10 +302,10 @@ int yaffs_IsManagedTempBuffer(yaffs_Device *dev, const __u8 *buffer)
  *  Simple hash function. Needs to have a reasonable spread
  */
 
-static Y_INLINE int yaffs_HashFunction(int n)
+static Y_INLINE int yaffs_HashFunction(yaffs_Device *dev, int n)
 {
 	n = abs(n);
-	return n % YAFFS_NOBJECT_BUCKETS;
+	return n & (dev->nObjectBuckets - 1);	/* always a power of 2 */
 }
 
 /*
@@ -468,6 +472,10 @@ static int yaffs_WriteNewChunkWithTagsToNAND(struct yaffs_DeviceStruct *dev,
 		/* Copy the data into the robustification buffer */
 		yaffs_HandleWriteChunkOk(dev, chunk, data, tags);
 
+		yaffs_SummaryAddChunk(dev, chunk, tags);
+
+		dev->nChunkWrites++;
+
 	} while (writeOk != YAFFS_OK &&
 		(yaffs_wr_attempts <= 0 || attempts <= yaffs_wr_attempts));
 
@@ -665,9 +673,23 @@ static void yaffs_FreeTnode(yaffs_Device *dev, yaffs_Tnode *tn)
 	dev->nCheckpointBlocksRequired = 0; /* force recalculation*/
 }
 
+static void yaffs_FreeObjectHash(yaffs_Device *dev)
+{
+	if (dev->objectBucket && dev->objectBucket != dev->initialObjectBucket) {
+		if (dev->objectBucketAlt)
+			YFREE_ALT(dev->objectBucket);
+		else
+			YFREE(dev->objectBucket);
+	}
+	dev->objectBucketAlt = 0;
+	dev->objectBucket = NULL;
+	dev->nObjectBuckets = 0;
+}
+
 static void yaffs_DeinitialiseTnodesAndObjects(yaffs_Device *dev)
 {
 	yaffs_DeinitialiseRawTnodesAndObjects(dev);
+	yaffs_FreeObjectHash(dev);
 	dev->nObjects = 0;
 	dev->nTnodes = 0;
 }
@@ -1290,7 +1312,7 @@ static void yaffs_UnhashObject(yaffs_Object *obj)
 	/* If it is still linked into the bucket list, free from the list */
 	if (!ylist_empty(&obj->hashLink)) {
 		ylist_del_init(&obj->hashLink);
-		bucket = yaffs_HashFunction(obj->objectId);
+		bucket = yaffs_HashFunction(dev, obj->objectId);
 		dev->objectBucket[bucket].count--;
 	}
 }
@@ -1341,12 +1363,67 @@ static void yaffs_InitialiseTnodesAndObjects(yaffs_Device *dev)
 
 	yaffs_InitialiseRawTnodesAndObjects(dev);
 
-	for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
+	dev->objectBucket = dev->initialObjectBucket;
+	dev->nObjectBuckets = YAFFS_NOBJECT_BUCKETS;
+	dev->objectBucketAlt = 0;
+
+	for (i = 0; i < dev->nObjectBuckets; i++) {
 		YINIT_LIST_HEAD(&dev->objectBucket[i].list);
 		dev->objectBucket[i].count = 0;
 	}
 }
 
+/*
+ * Double the object hash and move every object over to its new bucket.
+ * If the bigger table can't be had we just carry on with longer chains.
+ */
+static void yaffs_GrowObjectHash(yaffs_Device *dev)
+{
+	__u32 nBuckets = dev->nObjectBuckets * 2;
+	yaffs_ObjectBucket *buckets;
+	struct ylist_head *lh;
+	struct ylist_head *n;
+	yaffs_Object *obj;
+	int alt = 0;
+	int bucket;
+	int i;
+
+	if (nBuckets > YAFFS_MAX_NOBJECT_BUCKETS)
+		return;
+
+	buckets = YMALLOC(nBuckets * sizeof(yaffs_ObjectBucket));
+	if (!buckets) {
+		buckets = YMALLOC_ALT(nBuckets * sizeof(yaffs_ObjectBucket));
+		alt = 1;
+	}
+	if (!buckets)
+		return;
+
+	for (i = 0; i < nBuckets; i++) {
+		YINIT_LIST_HEAD(&buckets[i].list);
+		buckets[i].count = 0;
+	}
+
+	for (i = 0; i < dev->nObjectBuckets; i++) {
+		ylist_for_each_safe(lh, n, &dev->objectBucket[i].list) {
+			obj = ylist_entry(lh, yaffs_Object, hashLink);
+			bucket = obj->objectId & (nBuckets - 1);
+			ylist_del(&obj->hashLink);
+			ylist_add(&obj->hashLink, &buckets[bucket].list);
+			buckets[bucket].count++;
+		}
+	}
+
+	T(YAFFS_TRACE_ALLOCATE,
+	  (TSTR("yaffs: object hash grown to %d buckets for %d objects" TENDSTR),
+	   nBuckets, dev->nObjects));
+
+	yaffs_FreeObjectHash(dev);
+	dev->objectBucket = buckets;
+	dev->nObjectBuckets = nBuckets;
+	dev->objectBucketAlt = alt;
+}
+
 static int yaffs_FindNiceObjectBucket(yaffs_Device *dev)
 {
 	int i;
@@ -1360,7 +1437,7 @@ static int yaffs_FindNiceObjectBucket(yaffs_Device *dev)
 
 	for (i = 0; i < 10 && lowest > 4; i++) {
 		dev->bucketFinder++;
-		dev->bucketFinder %= YAFFS_NOBJECT_BUCKETS;
+		dev->bucketFinder %= dev->nObjectBuckets;
 		if (dev->objectBucket[dev->bucketFinder].count < lowest) {
 			lowest = dev->objectBucket[dev->bucketFinder].count;
 			l = dev->bucketFinder;
@@ -1388,7 +1465,7 @@ static int yaffs_CreateNewObjectNumber(yaffs_Device *dev)
 
 	while (!found) {
 		found = 1;
-		n += YAFFS_NOBJECT_BUCKETS;
+		n += dev->nObjectBuckets;
 		if (1 || dev->objectBucket[bucket].count > 0) {
 			ylist_for_each(i, &dev->objectBucket[bucket].list) {
 				/* If there is already one in the list */
@@ -1405,16 +1482,20 @@ static int yaffs_CreateNewObjectNumber(yaffs_Device *dev)
 
 static void yaffs_HashObject(yaffs_Object *in)
 {
-	int bucket = yaffs_HashFunction(in->objectId);
 	yaffs_Device *dev = in->myDev;
+	int bucket;
 
+	if (dev->nObjects > dev->nObjectBuckets * YAFFS_OBJECT_BUCKET_LOAD)
+		yaffs_GrowObjectHash(dev);
+
+	bucket = yaffs_HashFunction(dev, in->objectId);
 	ylist_add(&in->hashLink, &dev->objectBucket[bucket].list);
 	dev->objectBucket[bucket].count++;
 }
 
 yaffs_Object *yaffs_FindObjectByNumber(yaffs_Device *dev, __u32 number)
 {
-	int bucket = yaffs_HashFunction(number);
+	int bucket = yaffs_HashFunction(dev, number);
 	struct ylist_head *i;
 	yaffs_Object *in;
 
@@ -1824,6 +1905,9 @@ static int yaffs_InitialiseBlocks(yaffs_Device *dev)
 	dev->chunkBits = NULL;
 
 	dev->allocationBlock = -1;	/* force it to get a new one */
+	dev->otherStream.allocationBlock = -1;
+	dev->otherStream.summaryBlock = -1;
+	dev->allocatingCold = 0;
 
 	/* If the first allocation strategy fails, thry the alternate one */
 	dev->blockInfo = YMALLOC(nBlocks * sizeof(yaffs_BlockInfo));
@@ -2023,6 +2107,7 @@ static int yaffs_AllocateChunk(yaffs_Device *dev, int useReserve,
 		/* Get next block to allocate off */
 		dev->allocationBlock = yaffs_FindBlockForAllocation(dev);
 		dev->allocationPage = 0;
+		yaffs_SummaryStartBlock(dev, dev->allocationBlock);
 	}
 
 	if (!useReserve && !yaffs_CheckSpaceForAllocation(dev, 1)) {
@@ -2076,6 +2161,10 @@ static int yaffs_GetErasedChunks(yaffs_Device *dev)
 	if (dev->allocationBlock > 0)
 		n += (dev->param.nChunksPerBlock - dev->allocationPage);
 
+	if (dev->otherStream.allocationBlock > 0)
+		n += (dev->param.nChunksPerBlock -
+			dev->otherStream.allocationPage);
+
 	return n;
 
 }
@@ -2090,11 +2179,94 @@ void yaffs_SkipRestOfBlock(yaffs_Device *dev)
 		yaffs_BlockInfo *bi = yaffs_GetBlockInfo(dev, dev->allocationBlock);
 		if(bi->blockState == YAFFS_BLOCK_STATE_ALLOCATING){
 			bi->blockState = YAFFS_BLOCK_STATE_FULL;
+			dev->nSkippedChunks +=
+				dev->param.nChunksPerBlock - dev->allocationPage;
 			dev->allocationBlock = -1;
 		}
 	}
 }
 
+/*
+ * Hot/cold separation.
+ * Chunks that gc has to copy have outlived at least one block's worth of
+ * writes and are likely to stay put. Writing them into their own allocation
+ * block stops them being mixed back in with data that is about to be
+ * overwritten, so they don't get copied over and over.
+ *
+ * Scanning relies on a newer copy of a chunk being in a block with a higher
+ * sequence number than any older copy. Once there are two allocation blocks
+ * the one being written is not always the youngest, so each write that
+ * replaces a chunk checks the block holding the old copy, and the rest of
+ * the allocation block is only skipped when that one is younger.
+ */
+static void yaffs_SwapAllocationStreams(yaffs_Device *dev)
+{
+	yaffs_AllocationStream s = dev->otherStream;
+
+	dev->otherStream.allocationBlock = dev->allocationBlock;
+	dev->otherStream.allocationPage = dev->allocationPage;
+	dev->otherStream.summaryTags = dev->summaryTags;
+	dev->otherStream.summaryBlock = dev->summaryBlock;
+
+	dev->allocationBlock = s.allocationBlock;
+	dev->allocationPage = s.allocationPage;
+	dev->summaryTags = s.summaryTags;
+	dev->summaryBlock = s.summaryBlock;
+
+	dev->allocatingCold = !dev->allocatingCold;
+}
+
+static __u32 yaffs_AllocationSequence(yaffs_Device *dev)
+{
+	if (dev->allocationBlock > 0)
+		return yaffs_GetBlockInfo(dev, dev->allocationBlock)->sequenceNumber;
+	return 0;
+}
+
+static __u32 yaffs_ChunkSequence(yaffs_Device *dev, int chunkInNAND)
+{
+	return yaffs_GetBlockInfo(dev,
+			chunkInNAND / dev->param.nChunksPerBlock)->sequenceNumber;
+}
+
+/* Move on to a fresh block if the allocation block is older than sequenceNumber */
+static void yaffs_CheckAllocationOrder(yaffs_Device *dev, __u32 sequenceNumber)
+{
+	if (dev->param.isYaffs2 && dev->allocationBlock > 0 &&
+	    yaffs_AllocationSequence(dev) < sequenceNumber)
+		yaffs_SkipRestOfBlock(dev);
+}
+
+static void yaffs_StartGcCopies(yaffs_Device *dev, yaffs_BlockInfo *bi)
+{
+	/* Don't tie up a second block when we're into the reserve */
+	if (dev->param.isYaffs2 && !dev->param.gcGreedy &&
+	    dev->nErasedBlocks > dev->param.nReservedBlocks)
+		yaffs_SwapAllocationStreams(dev);
+
+	yaffs_CheckAllocationOrder(dev, bi->sequenceNumber);
+}
+
+static void yaffs_EndGcCopies(yaffs_Device *dev)
+{
+	if (dev->allocatingCold)
+		yaffs_SwapAllocationStreams(dev);
+}
+
+/*
+ * The checkpoint only records one allocation block, so the cold block is
+ * closed off before a checkpoint is written.
+ */
+void yaffs_SkipRestOfColdBlock(yaffs_Device *dev)
+{
+	if (dev->allocatingCold || dev->otherStream.allocationBlock <= 0)
+		return;
+
+	yaffs_SwapAllocationStreams(dev);
+	yaffs_SkipRestOfBlock(dev);
+	yaffs_SwapAllocationStreams(dev);
+}
+
 
 static int yaffs_GarbageCollectBlock(yaffs_Device *dev, int block,
 		int wholeBlock)
@@ -2149,6 +2321,8 @@ static int yaffs_GarbageCollectBlock(yaffs_Device *dev, int block,
 
 		yaffs_VerifyBlock(dev, bi, block);
 
+		yaffs_StartGcCopies(dev, bi);
+
 		maxCopies = (wholeBlock) ? dev->param.nChunksPerBlock : 5;
 		oldChunk = block * dev->param.nChunksPerBlock + dev->gcChunk;
 
@@ -2252,6 +2426,8 @@ static int yaffs_GarbageCollectBlock(yaffs_Device *dev, int block,
 					tags.serialNumber++;
 
 					dev->nGCCopies++;
+					if (dev->allocatingCold)
+						dev->nColdCopies++;
 
 					if (tags.chunkId == 0) {
 						/* It is an object Id,
@@ -2311,6 +2487,8 @@ static int yaffs_GarbageCollectBlock(yaffs_Device *dev, int block,
 			}
 		}
 
+		yaffs_EndGcCopies(dev);
+
 		yaffs_ReleaseTempBuffer(dev, buffer, __LINE__);
 
 
@@ -2368,9 +2546,28 @@ static int yaffs_GarbageCollectBlock(yaffs_Device *dev, int block,
 	return retVal;
 }
 
+/*
+ * Cost-benefit score of collecting a yaffs2 block: the space it frees,
+ * weighted by the block's age in sequence numbers, over the cost of copying
+ * its live chunks. A young block that is fairly dirty is likely to get
+ * dirtier by itself, whereas an old one has settled and may as well go.
+ */
+static __u32 yaffs_GcScore(yaffs_Device *dev, yaffs_BlockInfo *bi,
+				int pagesUsed)
+{
+	__u32 age = dev->sequenceNumber - bi->sequenceNumber;
+
+	if (age > YAFFS_GC_MAX_AGE)
+		age = YAFFS_GC_MAX_AGE;
+
+	return ((dev->param.nChunksPerBlock - pagesUsed) * (age + 1)) /
+		(pagesUsed + 1);
+}
+
 /*
  * FindBlockForgarbageCollection is used to select the dirtiest block (or close enough)
- * for garbage collection.
+ * for garbage collection. On yaffs2 the choice among dirty enough blocks is
+ * by cost-benefit rather than by dirtiness alone.
  */
 
 static unsigned yaffs_FindBlockForGarbageCollection(yaffs_Device *dev,
@@ -2384,6 +2581,7 @@ static unsigned yaffs_FindBlockForGarbageCollection(yaffs_Device *dev,
 	int prioritisedExists = 0;
 	yaffs_BlockInfo *bi;
 	int threshold;
+	int costBenefit = dev->param.isYaffs2 && !dev->param.gcGreedy;
 
 	/* First let's see if we need to grab a prioritised block */
 	if (dev->hasPendingPrioritisedGCs && !aggressive) {
@@ -2468,10 +2666,26 @@ static unsigned yaffs_FindBlockForGarbageCollection(yaffs_Device *dev,
 
 			pagesUsed = bi->pagesInUse - bi->softDeletions;
 
-			if (bi->blockState == YAFFS_BLOCK_STATE_FULL &&
-				pagesUsed < dev->param.nChunksPerBlock &&
-				(dev->gcDirtiest < 1 || pagesUsed < dev->gcPagesInUse) &&
-				yaffs2_BlockNotDisqualifiedFromGC(dev, bi)) {
+			if (bi->blockState != YAFFS_BLOCK_STATE_FULL ||
+				pagesUsed >= dev->param.nChunksPerBlock ||
+				!yaffs2_BlockNotDisqualifiedFromGC(dev, bi))
+				continue;
+
+			if (costBenefit) {
+				__u32 score;
+
+				if (pagesUsed > threshold)
+					continue;
+
+				score = yaffs_GcScore(dev, bi, pagesUsed);
+				if (dev->gcDirtiest < 1 ||
+					score > dev->gcDirtiestScore) {
+					dev->gcDirtiest = dev->gcBlockFinder;
+					dev->gcPagesInUse = pagesUsed;
+					dev->gcDirtiestScore = score;
+				}
+			} else if (dev->gcDirtiest < 1 ||
+					pagesUsed < dev->gcPagesInUse) {
 				dev->gcDirtiest = dev->gcBlockFinder;
 				dev->gcPagesInUse = pagesUsed;
 			}
@@ -2972,6 +3186,10 @@ static int yaffs_WriteChunkDataToObject(yaffs_Object *in, int chunkInInode,
 		(TSTR("Writing %d bytes to chunk!!!!!!!!!" TENDSTR), nBytes));
 		YBUG();
 	}
+
+	if (prevChunkId > 0)
+		yaffs_CheckAllocationOrder(dev,
+			yaffs_ChunkSequence(dev, prevChunkId));
 	
 		
 	newChunkId =
@@ -3131,6 +3349,17 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
 
 		yaffs_VerifyObjectHeader(in, oh, &newTags, 1);
 
+		/*
+		 * A shrink or shadowing header acts on chunks it doesn't
+		 * replace, which may sit in any block, so it goes into the
+		 * youngest one.
+		 */
+		if (isShrink || shadows > 0)
+			yaffs_CheckAllocationOrder(dev, dev->sequenceNumber);
+		else if (prevChunkId > 0)
+			yaffs_CheckAllocationOrder(dev,
+				yaffs_ChunkSequence(dev, prevChunkId));
+
 		/* Create new chunk in NAND */
 		newChunkId =
 		    yaffs_WriteNewChunkWithTagsToNAND(dev, buffer, &newTags,
@@ -3176,21 +3405,93 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   The cache can be made fairly large, so cache chunks are found through a
+ *   hash on (object, chunk) and replaced in least recently used order.
+ *   Dirty chunks are also kept on a list of their own so that flushing does
+ *   not have to look at clean ones. Flushing an object writes its dirty
+ *   chunks in chunk order and keeps them cached clean.
  */
 
+static Y_INLINE struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device *dev,
+						int objectId, int chunkId)
+{
+	return &dev->srHash[(objectId * 31 + chunkId) & dev->srHashMask];
+}
+
+static void yaffs_MarkChunkCacheDirty(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (!cache->dirty) {
+		cache->dirty = 1;
+		ylist_add_tail(&cache->dirtyList, &dev->srDirty);
+		dev->srNDirty++;
+	}
+}
+
+static void yaffs_MarkChunkCacheClean(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty) {
+		cache->dirty = 0;
+		ylist_del_init(&cache->dirtyList);
+		dev->srNDirty--;
+	}
+}
+
+/* Drop a cache chunk and make it the first to be reused */
+static void yaffs_DropChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	yaffs_MarkChunkCacheClean(dev, cache);
+	ylist_del_init(&cache->hashList);
+	cache->object = NULL;
+	ylist_del(&cache->lruList);
+	ylist_add_tail(&cache->lruList, &dev->srLru);
+}
+
+/* Hand a grabbed cache chunk over to a chunk of an object */
+static void yaffs_AssignChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
+				yaffs_Object *obj, int chunkId)
+{
+	cache->object = obj;
+	cache->chunkId = chunkId;
+	cache->dirty = 0;
+	cache->locked = 0;
+	cache->nBytes = 0;
+	ylist_add(&cache->hashList,
+		yaffs_ChunkCacheBucket(dev, obj->objectId, chunkId));
+}
+
+static yaffs_ChunkCache *yaffs_LookupChunkCache(const yaffs_Object *obj,
+						int chunkId)
+{
+	yaffs_Device *dev = obj->myDev;
+	struct ylist_head *bucket;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
+	if (dev->param.nShortOpCaches <= 0)
+		return NULL;
+
+	bucket = yaffs_ChunkCacheBucket(dev, obj->objectId, chunkId);
+	ylist_for_each(i, bucket) {
+		cache = ylist_entry(i, yaffs_ChunkCache, hashList);
+		if (cache->object == obj && cache->chunkId == chunkId)
+			return cache;
+	}
+
+	return NULL;
+}
+
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
-	int nCaches = obj->myDev->param.nShortOpCaches;
 
-	for (i = 0; i < nCaches; i++) {
-		cache = &dev->srCache[i];
-		if (cache->object == obj &&
-		    cache->dirty)
+	if (dev->param.nShortOpCaches <= 0)
+		return 0;
+
+	ylist_for_each(i, &dev->srDirty) {
+		cache = ylist_entry(i, yaffs_ChunkCache, dirtyList);
+		if (cache->object == obj)
 			return 1;
 	}
 
@@ -3201,31 +3502,27 @@ static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int lowest = -99;	/* Stop compiler whining. */
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
+	yaffs_ChunkCache *c;
 	int chunkWritten = 0;
-	int nCaches = obj->myDev->param.nShortOpCaches;
 
-	if (nCaches > 0) {
+	if (dev->param.nShortOpCaches > 0) {
 		do {
 			cache = NULL;
 
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->srCache[i].object == obj &&
-				    dev->srCache[i].dirty) {
-					if (!cache
-					    || dev->srCache[i].chunkId <
-					    lowest) {
-						cache = &dev->srCache[i];
-						lowest = cache->chunkId;
-					}
-				}
+			/* Find the dirty cache for this object with the lowest chunk id,
+			 * so that the object's chunks go out in order.
+			 */
+			ylist_for_each(i, &dev->srDirty) {
+				c = ylist_entry(i, yaffs_ChunkCache, dirtyList);
+				if (c->object == obj &&
+				    (!cache || c->chunkId < cache->chunkId))
+					cache = c;
 			}
 
 			if (cache && !cache->locked) {
-				/* Write it out and free it up */
+				/* Write it out, but keep it around for reading */
 
 				chunkWritten =
 				    yaffs_WriteChunkDataToObject(cache->object,
@@ -3233,13 +3530,13 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 								 cache->data,
 								 cache->nBytes,
 								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
+				yaffs_MarkChunkCacheClean(dev, cache);
+				dev->cacheWritebacks++;
 			}
 
-		} while (cache && chunkWritten > 0);
+		} while (cache && !cache->locked && chunkWritten > 0);
 
-		if (cache) {
+		if (cache && !cache->locked) {
 			/* Hoosterman, disk full while writing cache out. */
 			T(YAFFS_TRACE_ERROR,
 			  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
@@ -3256,42 +3553,45 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
 {
-	yaffs_Object *obj;
-	int nCaches = dev->param.nShortOpCaches;
-	int i;
-
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
-	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < nCaches && !obj; i++) {
-			if (dev->srCache[i].object &&
-			    dev->srCache[i].dirty)
-				obj = dev->srCache[i].object;
+	yaffs_ChunkCache *cache;
+	int nDirty;
 
-		}
-		if (obj)
-			yaffs_FlushFilesChunkCache(obj);
+	if (dev->param.nShortOpCaches <= 0)
+		return;
 
-	} while (obj);
+	/* Flush the object of the first dirty chunk...
+	 * until there are no further dirty chunks or we stop making progress.
+	 */
+	while (!ylist_empty(&dev->srDirty)) {
+		nDirty = dev->srNDirty;
+		cache = ylist_entry(dev->srDirty.next, yaffs_ChunkCache,
+					dirtyList);
+		yaffs_FlushFilesChunkCache(cache->object);
+		if (dev->srNDirty >= nDirty)
+			break;
+	}
 
 }
 
 
 /* Grab us a cache chunk for use.
- * First look for an empty one.
- * Then look for the least recently used non-dirty one.
- * Then look for the least recently used dirty one...., flush and look again.
+ * Take the least recently used chunk that is free or clean.
+ * If they are all dirty, flush the object of the least recently used dirty
+ * one and look again.
+ * The chunk returned is not attached to any object.
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 {
-	int i;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
 
-	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (!dev->srCache[i].object)
-				return &dev->srCache[i];
+	for (i = dev->srLru.prev; i != &dev->srLru; i = i->prev) {
+		cache = ylist_entry(i, yaffs_ChunkCache, lruList);
+		if (!cache->object ||
+		    (!cache->dirty && !cache->locked)) {
+			if (cache->object)
+				yaffs_DropChunkCache(dev, cache);
+			return cache;
 		}
 	}
 
@@ -3301,52 +3601,32 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
-
-	if (dev->param.nShortOpCaches > 0) {
-		/* Try find a non-dirty one... */
-
-		cache = yaffs_GrabChunkCacheWorker(dev);
-
-		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
-			 */
-
-			/* With locking we can't assume we can use entry zero */
+	struct ylist_head *i;
+	yaffs_Object *theObj = NULL;
 
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
+	if (dev->param.nShortOpCaches <= 0)
+		return NULL;
 
-			for (i = 0; i < dev->param.nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache)) {
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
-				}
-			}
+	cache = yaffs_GrabChunkCacheWorker(dev);
 
-			if (!cache || cache->dirty) {
-				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
-				cache = yaffs_GrabChunkCacheWorker(dev);
-			}
+	if (!cache) {
+		/* They were all dirty, flush the object owning the least
+		 * recently used unlocked chunk, then find again.
+		 */
+		for (i = dev->srLru.prev; i != &dev->srLru && !theObj; i = i->prev) {
+			cache = ylist_entry(i, yaffs_ChunkCache, lruList);
+			if (cache->object && !cache->locked)
+				theObj = cache->object;
+		}
 
+		cache = NULL;
+		if (theObj) {
+			yaffs_FlushFilesChunkCache(theObj);
+			cache = yaffs_GrabChunkCacheWorker(dev);
 		}
-		return cache;
-	} else
-		return NULL;
+	}
 
+	return cache;
 }
 
 /* Find a cached chunk */
@@ -3354,18 +3634,15 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
-	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
-				dev->cacheHits++;
+	yaffs_ChunkCache *cache = NULL;
 
-				return &dev->srCache[i];
-			}
-		}
+	if (dev->param.nShortOpCaches > 0) {
+		dev->cacheLookups++;
+		cache = yaffs_LookupChunkCache(obj, chunkId);
+		if (cache)
+			dev->cacheHits++;
 	}
-	return NULL;
+	return cache;
 }
 
 /* Mark the chunk for the least recently used algorithym */
@@ -3374,21 +3651,11 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 {
 
 	if (dev->param.nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->param.nShortOpCaches; i++)
-				dev->srCache[i].lastUse = 0;
-
-			dev->srLastUse = 0;
-		}
-
-		dev->srLastUse++;
-
-		cache->lastUse = dev->srLastUse;
+		ylist_del(&cache->lruList);
+		ylist_add(&cache->lruList, &dev->srLru);
 
 		if (isAWrite)
-			cache->dirty = 1;
+			yaffs_MarkChunkCacheDirty(dev, cache);
 	}
 }
 
@@ -3399,10 +3666,10 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
 {
 	if (object->myDev->param.nShortOpCaches > 0) {
-		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
+		yaffs_ChunkCache *cache = yaffs_LookupChunkCache(object, chunkId);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_DropChunkCache(object->myDev, cache);
 	}
 }
 
@@ -3418,7 +3685,7 @@ static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in)
 		/* Invalidate it. */
 		for (i = 0; i < dev->param.nShortOpCaches; i++) {
 			if (dev->srCache[i].object == in)
-				dev->srCache[i].object = NULL;
+				yaffs_DropChunkCache(dev, &dev->srCache[i]);
 		}
 	}
 }
@@ -3476,14 +3743,10 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 
 				if (!cache) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AssignChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
-					cache->nBytes = 0;
 				}
 
 				yaffs_UseChunkCache(dev, cache, 0);
@@ -3603,10 +3866,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 				if (!cache
 				    && yaffs_CheckSpaceForAllocation(dev, 1)) {
 					cache = yaffs_GrabChunkCache(dev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AssignChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->data);
 				} else if (cache &&
@@ -3637,7 +3897,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 						     cache->chunkId,
 						     cache->data, cache->nBytes,
 						     1);
-						cache->dirty = 0;
+						yaffs_MarkChunkCacheClean(dev, cache);
 					}
 
 				} else {
@@ -4263,7 +4523,7 @@ static void yaffs_FixHangingObjects(yaffs_Device *dev)
 	 * Make sure it is rooted.
 	 */
 
-	for (i = 0; i <  YAFFS_NOBJECT_BUCKETS; i++) {
+	for (i = 0; i <  dev->nObjectBuckets; i++) {
 		ylist_for_each_safe(lh, n, &dev->objectBucket[i].list) {
 			if (lh) {
 				obj = ylist_entry(lh, yaffs_Object, hashLink);
@@ -5293,6 +5553,10 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		init_failed = 1;
 
 	dev->srCache = NULL;
+	dev->srHash = NULL;
+	dev->srNDirty = 0;
+	YINIT_LIST_HEAD(&dev->srLru);
+	YINIT_LIST_HEAD(&dev->srDirty);
 	dev->gcCleanupList = NULL;
 
 
@@ -5300,31 +5564,48 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	    dev->param.nShortOpCaches > 0) {
 		int i;
 		void *buf;
-		int srCacheBytes = dev->param.nShortOpCaches * sizeof(yaffs_ChunkCache);
+		int srCacheBytes;
+		int nBuckets = 16;
 
 		if (dev->param.nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->param.nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
 
+		srCacheBytes = dev->param.nShortOpCaches * sizeof(yaffs_ChunkCache);
+
+		/* About one cache chunk per hash bucket */
+		while (nBuckets < dev->param.nShortOpCaches)
+			nBuckets <<= 1;
+
 		dev->srCache =  YMALLOC(srCacheBytes);
+		dev->srHash = YMALLOC(nBuckets * sizeof(struct ylist_head));
+		dev->srHashMask = nBuckets - 1;
 
 		buf = (__u8 *) dev->srCache;
 
 		if (dev->srCache)
 			memset(dev->srCache, 0, srCacheBytes);
 
+		if (dev->srHash)
+			for (i = 0; i < nBuckets; i++)
+				YINIT_LIST_HEAD(&dev->srHash[i]);
+		else
+			buf = NULL;
+
 		for (i = 0; i < dev->param.nShortOpCaches && buf; i++) {
 			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
 			dev->srCache[i].dirty = 0;
+			YINIT_LIST_HEAD(&dev->srCache[i].hashList);
+			YINIT_LIST_HEAD(&dev->srCache[i].dirtyList);
+			ylist_add_tail(&dev->srCache[i].lruList, &dev->srLru);
 			dev->srCache[i].data = buf = YMALLOC_DMA(dev->param.totalBytesPerChunk);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->srLastUse = 0;
 	}
 
 	dev->cacheHits = 0;
+	dev->cacheLookups = 0;
+	dev->cacheWritebacks = 0;
 
 	if (!init_failed) {
 		dev->gcCleanupList = YMALLOC(dev->param.nChunksPerBlock * sizeof(__u32));
@@ -5332,6 +5613,9 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 			init_failed = 1;
 	}
 
+	if (!init_failed && !yaffs_SummaryInitialise(dev))
+		init_failed = 1;
+
 	if (dev->param.isYaffs2)
 		dev->param.useHeaderFileSize = 1;
 
@@ -5402,6 +5686,9 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	dev->nPageWrites = 0;
 	dev->nBlockErasures = 0;
 	dev->nGCCopies = 0;
+	dev->nChunkWrites = 0;
+	dev->nColdCopies = 0;
+	dev->nSkippedChunks = 0;
 	dev->nRetriedWrites = 0;
 
 	dev->nRetiredBlocks = 0;
@@ -5439,8 +5726,14 @@ void yaffs_Deinitialise(yaffs_Device *dev)
 			dev->srCache = NULL;
 		}
 
+		if (dev->srHash)
+			YFREE(dev->srHash);
+		dev->srHash = NULL;
+
 		YFREE(dev->gcCleanupList);
 
+		yaffs_SummaryDeinitialise(dev);
+
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
 			YFREE(dev->tempBuffer[i].buffer);
 
@@ -5483,9 +5776,7 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 	/* This is what we report to the outside world */
 
 	int nFree;
-	int nDirtyCacheChunks;
 	int blocksForCheckpoint;
-	int i;
 
 #if 1
 	nFree = dev->nFreeChunks;
@@ -5495,14 +5786,9 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 
 	nFree += dev->nDeletedFiles;
 
-	/* Now count the number of dirty chunks in the cache and subtract those */
-
-	for (nDirtyCacheChunks = 0, i = 0; i < dev->param.nShortOpCaches; i++) {
-		if (dev->srCache[i].dirty)
-			nDirtyCacheChunks++;
-	}
+	/* Now subtract the number of dirty chunks in the cache */
 
-	nFree -= nDirtyCacheChunks;
+	nFree -= dev->srNDirty;
 
 	nFree -= ((dev->param.nReservedBlocks + 1) * dev->param.nChunksPerBlock);
 
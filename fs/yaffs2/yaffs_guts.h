@@ -58,7 +58,13 @@
 #define YAFFS_ALLOCATION_NTNODES	100
 #define YAFFS_ALLOCATION_NLINKS		100
 
+/*
+ * The object hash starts with YAFFS_NOBJECT_BUCKETS and doubles whenever the
+ * average chain grows past YAFFS_OBJECT_BUCKET_LOAD, up to a limit.
+ */
 #define YAFFS_NOBJECT_BUCKETS		256
+#define YAFFS_MAX_NOBJECT_BUCKETS	16384
+#define YAFFS_OBJECT_BUCKET_LOAD	4
 
 
 #define YAFFS_OBJECT_SPACE		0x40000
@@ -87,8 +93,14 @@
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
+/* Pseudo object id for block summaries. This is deliberately outside the
+ * object id space so that scanners which don't know about summaries
+ * discard the summary chunk as a chunk with bad tags.
+ */
+#define YAFFS_OBJECTID_SUMMARY		(YAFFS_OBJECT_SPACE + 0x10)
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+
+#define YAFFS_MAX_SHORT_OP_CACHES	256
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -113,9 +125,11 @@
 
 /* ChunkCache is used for short read/write operations.*/
 typedef struct {
+	struct ylist_head lruList;	/* Most recently used first */
+	struct ylist_head hashList;	/* (object, chunk) hash chain */
+	struct ylist_head dirtyList;	/* On the dirty list while dirty */
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -602,10 +616,20 @@ struct yaffs_DeviceParamStruct {
 	int autoUnicode;
 #endif
 	int alwaysCheckErased; /* Force chunk erased check always on */
+	int disableSummary;	/* Don't write block summaries (yaffs2 only) */
+	int gcGreedy;		/* Pick gc victims by fewest live chunks only and
+				 * don't separate gc copies from new data */
 };
 
 typedef struct yaffs_DeviceParamStruct yaffs_DeviceParam;
 
+typedef struct {
+	int allocationBlock;
+	__u32 allocationPage;
+	struct yaffs_SummaryTagsStruct *summaryTags;
+	int summaryBlock;
+} yaffs_AllocationStream;
+
 struct yaffs_DeviceStruct {
 	struct yaffs_DeviceParamStruct param;
 
@@ -680,6 +704,12 @@ struct yaffs_DeviceStruct {
 	__u32 allocationPage;
 	int allocationBlockFinder;	/* Used to search for next allocation block */
 
+	/* Chunks copied by gc are written to a separate allocation block from
+	 * new data. The state of whichever stream is not in use is kept here.
+	 */
+	yaffs_AllocationStream otherStream;
+	unsigned allocatingCold:1;	/* Set while gc copies are being written */
+
 	/* Object and Tnode memory management */
 	void *allocator;
 	int nObjects;
@@ -687,7 +717,10 @@ struct yaffs_DeviceStruct {
 
 	int nHardLinks;
 
-	yaffs_ObjectBucket objectBucket[YAFFS_NOBJECT_BUCKETS];
+	yaffs_ObjectBucket *objectBucket;
+	__u32 nObjectBuckets;
+	unsigned objectBucketAlt:1;	/* was allocated using alternative strategy */
+	yaffs_ObjectBucket initialObjectBucket[YAFFS_NOBJECT_BUCKETS];
 	__u32 bucketFinder;
 
 	int nFreeChunks;
@@ -701,6 +734,7 @@ struct yaffs_DeviceStruct {
 	unsigned gcBlockFinder;
 	unsigned gcDirtiest;
 	unsigned gcPagesInUse;
+	__u32 gcDirtiestScore;
 	unsigned gcNotDone;
 	unsigned gcBlock;
 	unsigned gcChunk;
@@ -719,7 +753,11 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head srLru;	/* Cache chunks, most recently used first */
+	struct ylist_head *srHash;	/* Cache chunks by (object, chunk) */
+	int srHashMask;
+	struct ylist_head srDirty;	/* Dirty cache chunks */
+	int srNDirty;
 
 	/* Stuff for background deletion and unlinked files.*/
 	yaffs_Object *unlinkedDir;	/* Directory where unlinked and deleted files live. */
@@ -741,6 +779,10 @@ struct yaffs_DeviceStruct {
 	unsigned oldestDirtySequence;
 	unsigned oldestDirtyBlock;
 
+	/* Block summaries for the allocation block. See yaffs_summary.c */
+	struct yaffs_SummaryTagsStruct *summaryTags;
+	int summaryBlock;	/* Block the summary tags describe, -1 if none */
+
 	/* Block refreshing */
 	int refreshSkip;	/* A skip down counter. Refresh happens when this gets to zero. */
 
@@ -769,6 +811,13 @@ struct yaffs_DeviceStruct {
 	__u32 nUnmarkedDeletions;
 	__u32 refreshCount;
 	__u32 cacheHits;
+	__u32 cacheLookups;
+	__u32 cacheWritebacks;
+	__u32 nChunkWrites;
+	__u32 nColdCopies;
+	__u32 nSkippedChunks;	/* Erased pages lost to sealing a block early */
+	__u32 nSummaryWrites;
+	__u32 nSummaryScans;
 
 };
 
@@ -957,6 +1006,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 			int nBytes, int writeThrough);
 void yaffs_ResizeDown( yaffs_Object *obj, loff_t newSize);
 void yaffs_SkipRestOfBlock(yaffs_Device *dev);
+void yaffs_SkipRestOfColdBlock(yaffs_Device *dev);
 
 int yaffs_CountFreeChunks(yaffs_Device *dev);
 
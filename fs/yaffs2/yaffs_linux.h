@@ -25,14 +25,16 @@ struct yaffs_LinuxContext {
 	struct super_block * superBlock;
 	struct task_struct *bgThread; /* Background thread for this device */
 	int bgRunning;
-        struct semaphore grossLock;     /* Gross locking semaphore */
+	struct rw_semaphore grossLock;	/* Gross lock, shared by read-only paths */
+	struct mutex gutsLock;		/* Serialises the shared holders in guts */
 	__u8 *spareBuffer;      /* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
 				 */
 	struct ylist_head searchContexts;
 	void (*putSuperFunc)(struct super_block *sb);
 
-	struct task_struct *readdirProcess;
+	struct ylist_head readdirTasks;	/* Tasks in readdir holding the locks */
+	spinlock_t readdirLock;
 	unsigned mount_id;
 };
 
@@ -0,0 +1,301 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Per-block summaries for yaffs2.
+ *
+ * While a block is being allocated from, the tags of each chunk written to
+ * it are gathered up. When only the last page of the block is left, the
+ * gathered tags are written into that page and the block is sealed.
+ *
+ * During the backwards scan a block with a valid summary is scanned by
+ * reading that one chunk instead of the tags of every chunk. Object headers
+ * still have their tags read since the scanner wants the extra header info.
+ *
+ * The summary chunk carries an object id outside the object id space, so
+ * older code scanning the same flash ignores it as a chunk with bad tags.
+ * Blocks without a summary (written by older code, sealed early because of
+ * a write error, or the block being allocated from at the time of the last
+ * checkpoint or mount) are scanned in full as before.
+ *
+ * The summary page is never marked in use, so it is accounted as a dirty
+ * chunk and goes away when the block is garbage collected.
+ */
+
+#include "yaffs_summary.h"
+#include "yaffs_trace.h"
+#include "yaffs_nand.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_tagsvalidity.h"
+
+#define YAFFS_SUMMARY_VERSION	1
+
+typedef struct yaffs_SummaryTagsStruct {
+	__u32 objectId;
+	__u32 chunkId;
+	__u32 byteCount;
+} yaffs_SummaryTags;
+
+typedef struct {
+	__u32 version;
+	__u32 block;
+	__u32 sequenceNumber;
+	__u32 sum;
+} yaffs_SummaryHeader;
+
+static Y_INLINE int yaffs_SummaryEntries(yaffs_Device *dev)
+{
+	/* Every page but the last, which holds the summary itself */
+	return dev->param.nChunksPerBlock - 1;
+}
+
+static Y_INLINE int yaffs_SummaryBytes(yaffs_Device *dev)
+{
+	return sizeof(yaffs_SummaryHeader) +
+		yaffs_SummaryEntries(dev) * sizeof(yaffs_SummaryTags);
+}
+
+static __u32 yaffs_SummarySum(yaffs_Device *dev, const yaffs_SummaryHeader *hdr)
+{
+	const __u32 *p = (const __u32 *)(hdr + 1);
+	int nWords = yaffs_SummaryEntries(dev) *
+			sizeof(yaffs_SummaryTags) / sizeof(__u32);
+	__u32 sum = hdr->version ^ hdr->block ^ hdr->sequenceNumber;
+
+	while (nWords-- > 0) {
+		sum = (sum << 1) | (sum >> 31);
+		sum ^= *p++;
+	}
+
+	return sum;
+}
+
+int yaffs_SummaryInitialise(yaffs_Device *dev)
+{
+	dev->summaryTags = NULL;
+	dev->summaryBlock = -1;
+	dev->otherStream.summaryTags = NULL;
+	dev->otherStream.summaryBlock = -1;
+	dev->nSummaryWrites = 0;
+	dev->nSummaryScans = 0;
+
+	/* Summaries need yaffs2 tags in the spare area and have to fit in
+	 * one chunk. Without them we just scan the way we always did.
+	 */
+	if (!dev->param.isYaffs2 || dev->param.inbandTags ||
+	    dev->param.nChunksPerBlock < 2 ||
+	    yaffs_SummaryBytes(dev) > dev->nDataBytesPerChunk)
+		return YAFFS_OK;
+
+	/* One for each allocation stream */
+	dev->summaryTags = YMALLOC(dev->param.nChunksPerBlock *
+					sizeof(yaffs_SummaryTags));
+	dev->otherStream.summaryTags = YMALLOC(dev->param.nChunksPerBlock *
+					sizeof(yaffs_SummaryTags));
+
+	/* Not fatal, we can live without summaries */
+	if (!dev->summaryTags || !dev->otherStream.summaryTags) {
+		T(YAFFS_TRACE_ERROR,
+		  (TSTR("yaffs: no memory for block summaries" TENDSTR)));
+		yaffs_SummaryDeinitialise(dev);
+	}
+
+	return YAFFS_OK;
+}
+
+void yaffs_SummaryDeinitialise(yaffs_Device *dev)
+{
+	if (dev->summaryTags)
+		YFREE(dev->summaryTags);
+	if (dev->otherStream.summaryTags)
+		YFREE(dev->otherStream.summaryTags);
+	dev->summaryTags = NULL;
+	dev->summaryBlock = -1;
+	dev->otherStream.summaryTags = NULL;
+	dev->otherStream.summaryBlock = -1;
+}
+
+/*
+ * Called when a fresh block is picked for allocation. Blocks we did not
+ * see from their first chunk can't be summarised.
+ */
+void yaffs_SummaryStartBlock(yaffs_Device *dev, int blk)
+{
+	dev->summaryBlock = -1;
+
+	if (!dev->summaryTags || dev->param.disableSummary || blk < 0)
+		return;
+
+	memset(dev->summaryTags, 0,
+		dev->param.nChunksPerBlock * sizeof(yaffs_SummaryTags));
+	dev->summaryBlock = blk;
+}
+
+static void yaffs_SummaryWrite(yaffs_Device *dev, int blk)
+{
+	yaffs_ExtendedTags tags;
+	yaffs_BlockInfo *bi = yaffs_GetBlockInfo(dev, blk);
+	__u8 *buffer = yaffs_GetTempBuffer(dev, __LINE__);
+	yaffs_SummaryHeader *hdr = (yaffs_SummaryHeader *)buffer;
+	int nEntries = yaffs_SummaryEntries(dev);
+	int result;
+
+	memset(buffer, 0xff, dev->nDataBytesPerChunk);
+	hdr->version = YAFFS_SUMMARY_VERSION;
+	hdr->block = blk;
+	hdr->sequenceNumber = bi->sequenceNumber;
+	memcpy(hdr + 1, dev->summaryTags,
+		nEntries * sizeof(yaffs_SummaryTags));
+	hdr->sum = yaffs_SummarySum(dev, hdr);
+
+	yaffs_InitialiseTags(&tags);
+	tags.objectId = YAFFS_OBJECTID_SUMMARY;
+	tags.chunkId = 1;
+	tags.byteCount = yaffs_SummaryBytes(dev);
+
+	result = yaffs_WriteChunkWithTagsToNAND(dev,
+			blk * dev->param.nChunksPerBlock + nEntries,
+			buffer, &tags);
+
+	yaffs_ReleaseTempBuffer(dev, buffer, __LINE__);
+
+	/* A failed summary write costs nothing but a slower scan, since a
+	 * summary that does not verify is ignored.
+	 */
+	if (result == YAFFS_OK)
+		dev->nSummaryWrites++;
+	else
+		T(YAFFS_TRACE_ERROR,
+		  (TSTR("yaffs: summary write for block %d failed" TENDSTR),
+		  blk));
+}
+
+/*
+ * Called after a chunk has been written successfully. Once all but the
+ * last page of the allocation block is written, the summary goes into the
+ * last page and the block is sealed.
+ */
+void yaffs_SummaryAddChunk(yaffs_Device *dev, int chunkInNAND,
+			const yaffs_ExtendedTags *tags)
+{
+	int blk = chunkInNAND / dev->param.nChunksPerBlock;
+	int c = chunkInNAND % dev->param.nChunksPerBlock;
+	yaffs_SummaryTags *st;
+	yaffs_BlockInfo *bi;
+
+	if (!dev->summaryTags || blk != dev->summaryBlock ||
+	    c >= yaffs_SummaryEntries(dev))
+		return;
+
+	st = &dev->summaryTags[c];
+	st->objectId = tags->objectId;
+	st->chunkId = tags->chunkId;
+	st->byteCount = tags->byteCount;
+
+	if (blk != dev->allocationBlock ||
+	    dev->allocationPage < yaffs_SummaryEntries(dev))
+		return;
+
+	yaffs_SummaryWrite(dev, blk);
+
+	bi = yaffs_GetBlockInfo(dev, blk);
+	if (bi->blockState == YAFFS_BLOCK_STATE_ALLOCATING)
+		bi->blockState = YAFFS_BLOCK_STATE_FULL;
+	dev->allocationBlock = -1;
+	dev->summaryBlock = -1;
+}
+
+/*
+ * Read the summary of a block that needs scanning.
+ * Returns 1 if the block can be scanned from its summary.
+ */
+int yaffs_SummaryRead(yaffs_Device *dev, int blk, yaffs_BlockInfo *bi)
+{
+	yaffs_ExtendedTags tags;
+	yaffs_SummaryHeader *hdr;
+	__u8 *buffer;
+	int result;
+	int ok;
+
+	if (!dev->summaryTags)
+		return 0;
+
+	dev->summaryBlock = -1;
+
+	buffer = yaffs_GetTempBuffer(dev, __LINE__);
+	hdr = (yaffs_SummaryHeader *)buffer;
+
+	result = yaffs_ReadChunkWithTagsFromNAND(dev,
+			blk * dev->param.nChunksPerBlock +
+			yaffs_SummaryEntries(dev),
+			buffer, &tags);
+
+	ok = (result == YAFFS_OK &&
+		tags.chunkUsed &&
+		tags.eccResult != YAFFS_ECC_RESULT_UNFIXED &&
+		tags.objectId == YAFFS_OBJECTID_SUMMARY &&
+		tags.sequenceNumber == bi->sequenceNumber &&
+		hdr->version == YAFFS_SUMMARY_VERSION &&
+		hdr->block == blk &&
+		hdr->sequenceNumber == bi->sequenceNumber &&
+		hdr->sum == yaffs_SummarySum(dev, hdr));
+
+	if (ok) {
+		memcpy(dev->summaryTags, hdr + 1,
+			yaffs_SummaryEntries(dev) * sizeof(yaffs_SummaryTags));
+		dev->nSummaryScans++;
+	}
+
+	yaffs_ReleaseTempBuffer(dev, buffer, __LINE__);
+
+	T(YAFFS_TRACE_SCAN_DEBUG,
+	  (TSTR("Block %d summary %s" TENDSTR), blk, ok ? "ok" : "not used"));
+
+	return ok;
+}
+
+/*
+ * Produce the tags of a chunk in a block whose summary was read by
+ * yaffs_SummaryRead(), as the scanner would have read them.
+ */
+int yaffs_SummaryFetchTags(yaffs_Device *dev, int blk, int chunkInBlock,
+			yaffs_ExtendedTags *tags)
+{
+	yaffs_SummaryTags *st = &dev->summaryTags[chunkInBlock];
+
+	if (chunkInBlock < yaffs_SummaryEntries(dev) &&
+	    st->objectId && st->chunkId == 0)
+		/* Object headers carry extra info in their tags */
+		return yaffs_ReadChunkWithTagsFromNAND(dev,
+				blk * dev->param.nChunksPerBlock + chunkInBlock,
+				NULL, tags);
+
+	yaffs_InitialiseTags(tags);
+	tags->chunkUsed = 1;
+	tags->eccResult = YAFFS_ECC_RESULT_NO_ERROR;
+	tags->sequenceNumber = yaffs_GetBlockInfo(dev, blk)->sequenceNumber;
+
+	if (chunkInBlock >= yaffs_SummaryEntries(dev) || !st->objectId) {
+		/* The summary itself, or a chunk skipped during writing.
+		 * Either way the scanner discards it.
+		 */
+		tags->objectId = YAFFS_OBJECTID_SUMMARY;
+		tags->chunkId = 1;
+	} else {
+		tags->objectId = st->objectId;
+		tags->chunkId = st->chunkId;
+		tags->byteCount = st->byteCount;
+	}
+
+	return YAFFS_OK;
+}
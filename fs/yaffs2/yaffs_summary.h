@@ -0,0 +1,34 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Per-block summaries for yaffs2
+ */
+
+#ifndef __YAFFS_SUMMARY_H__
+#define __YAFFS_SUMMARY_H__
+
+#include "yaffs_guts.h"
+
+int yaffs_SummaryInitialise(yaffs_Device *dev);
+void yaffs_SummaryDeinitialise(yaffs_Device *dev);
+
+void yaffs_SummaryStartBlock(yaffs_Device *dev, int blk);
+void yaffs_SummaryAddChunk(yaffs_Device *dev, int chunkInNAND,
+			const yaffs_ExtendedTags *tags);
+
+int yaffs_SummaryRead(yaffs_Device *dev, int blk, yaffs_BlockInfo *bi);
+int yaffs_SummaryFetchTags(yaffs_Device *dev, int blk, int chunkInBlock,
+			yaffs_ExtendedTags *tags);
+
+#endif
@@ -74,6 +74,7 @@
 #include <linux/proc_fs.h>
 #include <linux/smp_lock.h>
 #include <linux/pagemap.h>
+#include <linux/writeback.h>
 #include <linux/mtd/mtd.h>
 #include <linux/interrupt.h>
 #include <linux/string.h>
@@ -146,6 +147,15 @@
 #define YAFFS_USE_WRITE_BEGIN_END 0
 #endif
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 22))
+#define YAFFS_USE_PAGE_BATCHING 1
+#else
+#define YAFFS_USE_PAGE_BATCHING 0
+#endif
+
+/* Max pages read or written under one hold of the gross lock */
+#define YAFFS_PAGE_BATCH 16
+
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 28))
 static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 {
@@ -158,6 +168,7 @@ static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 #endif
 
 #include <linux/uaccess.h>
+#include <asm/div64.h>
 #include <linux/mtd/mtd.h>
 
 #include "yportenv.h"
@@ -176,6 +187,13 @@ unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
 
+/* Default number of short op cache chunks per mount, see "cache-size=" */
+#ifdef CONFIG_YAFFS_SHORT_OP_CACHES
+#define YAFFS_SHORT_OP_CACHES CONFIG_YAFFS_SHORT_OP_CACHES
+#else
+#define YAFFS_SHORT_OP_CACHES 10
+#endif
+
 /* Module Parameters */
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 module_param(yaffs_traceMask, uint, 0644);
@@ -305,6 +323,12 @@ static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
 static int yaffs_writepage(struct page *page);
 #endif
+#if (YAFFS_USE_PAGE_BATCHING > 0)
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages);
+static int yaffs_writepages(struct address_space *mapping,
+				struct writeback_control *wbc);
+#endif
 
 #ifdef CONFIG_YAFFS_XATTR
 int yaffs_setxattr(struct dentry *dentry, const char *name,
@@ -350,6 +374,10 @@ static int yaffs_vfs_setattr(struct inode *, struct iattr *);
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
 	.writepage = yaffs_writepage,
+#if (YAFFS_USE_PAGE_BATCHING > 0)
+	.readpages = yaffs_readpages,
+	.writepages = yaffs_writepages,
+#endif
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
 	.write_end = yaffs_write_end,
@@ -515,14 +543,107 @@ static unsigned yaffs_gc_control_callback(yaffs_Device *dev)
 static void yaffs_GrossLock(yaffs_Device *dev)
 {
 	T(YAFFS_TRACE_LOCK, (TSTR("yaffs locking %p\n"), current));
-	down(&(yaffs_DeviceToLC(dev)->grossLock));
+	down_write(&(yaffs_DeviceToLC(dev)->grossLock));
 	T(YAFFS_TRACE_LOCK, (TSTR("yaffs locked %p\n"), current));
 }
 
 static void yaffs_GrossUnlock(yaffs_Device *dev)
 {
 	T(YAFFS_TRACE_LOCK, (TSTR("yaffs unlocking %p\n"), current));
-	up(&(yaffs_DeviceToLC(dev)->grossLock));
+	up_write(&(yaffs_DeviceToLC(dev)->grossLock));
+}
+
+static int yaffs_GrossTryLock(yaffs_Device *dev)
+{
+	if (!down_write_trylock(&(yaffs_DeviceToLC(dev)->grossLock)))
+		return 0;
+	T(YAFFS_TRACE_LOCK, (TSTR("yaffs locked %p\n"), current));
+	return 1;
+}
+
+/*
+ * Shared locking is for paths that don't change the file system: lookup,
+ * readdir, readpage, readlink and statfs. They run alongside each other
+ * but not alongside anything holding the lock exclusively.
+ */
+static void yaffs_GrossLockShared(yaffs_Device *dev)
+{
+	T(YAFFS_TRACE_LOCK, (TSTR("yaffs shared locking %p\n"), current));
+	down_read(&(yaffs_DeviceToLC(dev)->grossLock));
+}
+
+static void yaffs_GrossUnlockShared(yaffs_Device *dev)
+{
+	T(YAFFS_TRACE_LOCK, (TSTR("yaffs shared unlocking %p\n"), current));
+	up_read(&(yaffs_DeviceToLC(dev)->grossLock));
+}
+
+/*
+ * Even a read goes through state in yaffs_guts that isn't safe to touch
+ * concurrently: the short op cache, the temp buffers, the mtdif2 spare
+ * buffer and lazy loading of object details. Shared holders of the gross
+ * lock take gutsLock around each call into it. It costs little, as the
+ * NAND reads underneath are serialised by the MTD driver anyway. Exclusive
+ * holders already have the device to themselves and don't take it.
+ */
+static void yaffs_GutsLock(yaffs_Device *dev)
+{
+	mutex_lock(&(yaffs_DeviceToLC(dev)->gutsLock));
+}
+
+static void yaffs_GutsUnlock(yaffs_Device *dev)
+{
+	mutex_unlock(&(yaffs_DeviceToLC(dev)->gutsLock));
+}
+
+/*
+ * Several readdirs can hold the gross lock shared at once, so each one
+ * notes its task on the device while it holds the locks. Lookup and iget
+ * called by such a task already have them and must not take them again.
+ */
+struct yaffs_ReaddirTask {
+	struct ylist_head list;
+	struct task_struct *task;
+};
+
+static void yaffs_ReaddirLock(yaffs_Device *dev, struct yaffs_ReaddirTask *rt)
+{
+	struct yaffs_LinuxContext *lc = yaffs_DeviceToLC(dev);
+
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
+	rt->task = current;
+	spin_lock(&lc->readdirLock);
+	ylist_add(&rt->list, &lc->readdirTasks);
+	spin_unlock(&lc->readdirLock);
+}
+
+static void yaffs_ReaddirUnlock(yaffs_Device *dev, struct yaffs_ReaddirTask *rt)
+{
+	struct yaffs_LinuxContext *lc = yaffs_DeviceToLC(dev);
+
+	spin_lock(&lc->readdirLock);
+	ylist_del(&rt->list);
+	spin_unlock(&lc->readdirLock);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
+}
+
+static int yaffs_InReaddir(yaffs_Device *dev)
+{
+	struct yaffs_LinuxContext *lc = yaffs_DeviceToLC(dev);
+	struct ylist_head *i;
+	int found = 0;
+
+	spin_lock(&lc->readdirLock);
+	ylist_for_each(i, &lc->readdirTasks) {
+		if (ylist_entry(i, struct yaffs_ReaddirTask, list)->task == current) {
+			found = 1;
+			break;
+		}
+	}
+	spin_unlock(&lc->readdirLock);
+	return found;
 }
 
 #ifdef YAFFS_COMPILE_EXPORTFS
@@ -714,11 +835,13 @@ static int yaffs_readlink(struct dentry *dentry, char __user *buffer,
 
 	yaffs_Device *dev = yaffs_DentryToObject(dentry)->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
 	alias = yaffs_GetSymlinkAlias(yaffs_DentryToObject(dentry));
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 
 	if (!alias)
 		return -ENOMEM;
@@ -738,10 +861,12 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd)
 	int ret;
 	yaffs_Device *dev = yaffs_DentryToObject(dentry)->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
 	alias = yaffs_GetSymlinkAlias(yaffs_DentryToObject(dentry));
-	yaffs_GrossUnlock(dev);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 
 	if (!alias) {
 		ret = -ENOMEM;
@@ -785,9 +910,12 @@ static struct dentry *yaffs_lookup(struct inode *dir, struct dentry *dentry)
 	struct inode *inode = NULL;	/* NCB 2.5/2.6 needs NULL here */
 
 	yaffs_Device *dev = yaffs_InodeToObject(dir)->myDev;
+	int inReaddir = yaffs_InReaddir(dev);
 
-	if(current != yaffs_DeviceToLC(dev)->readdirProcess)
-		yaffs_GrossLock(dev);
+	if(!inReaddir){
+		yaffs_GrossLockShared(dev);
+		yaffs_GutsLock(dev);
+	}
 
 	T(YAFFS_TRACE_OS,
 		(TSTR("yaffs_lookup for %d:%s\n"),
@@ -799,8 +927,10 @@ static struct dentry *yaffs_lookup(struct inode *dir, struct dentry *dentry)
 	obj = yaffs_GetEquivalentObject(obj);	/* in case it was a hardlink */
 
 	/* Can't hold gross lock when calling yaffs_get_inode() */
-	if(current != yaffs_DeviceToLC(dev)->readdirProcess)
-		yaffs_GrossUnlock(dev);
+	if(!inReaddir){
+		yaffs_GutsUnlock(dev);
+		yaffs_GrossUnlockShared(dev);
+	}
 
 	if (obj) {
 		T(YAFFS_TRACE_OS,
@@ -985,12 +1115,44 @@ static int yaffs_file_flush(struct file *file)
 	return 0;
 }
 
+/*
+ * Fill a locked page from the object. Caller holds the gross lock shared
+ * and gutsLock.
+ */
+static int yaffs_readpage_fill(yaffs_Object *obj, struct page *pg)
+{
+	unsigned char *pg_buf;
+	int ret;
+
+	pg_buf = kmap(pg);
+	/* FIXME: Can kmap fail? */
+
+	ret = yaffs_ReadDataFromFile(obj, pg_buf,
+				pg->index << PAGE_CACHE_SHIFT,
+				PAGE_CACHE_SIZE);
+
+	if (ret >= 0)
+		ret = 0;
+
+	if (ret) {
+		ClearPageUptodate(pg);
+		SetPageError(pg);
+	} else {
+		SetPageUptodate(pg);
+		ClearPageError(pg);
+	}
+
+	flush_dcache_page(pg);
+	kunmap(pg);
+
+	return ret;
+}
+
 static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 {
 	/* Lifted from jffs2 */
 
 	yaffs_Object *obj;
-	unsigned char *pg_buf;
 	int ret;
 
 	yaffs_Device *dev;
@@ -1011,30 +1173,13 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 		PAGE_BUG(pg);
 #endif
 
-	pg_buf = kmap(pg);
-	/* FIXME: Can kmap fail? */
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
-	yaffs_GrossLock(dev);
-
-	ret = yaffs_ReadDataFromFile(obj, pg_buf,
-				pg->index << PAGE_CACHE_SHIFT,
-				PAGE_CACHE_SIZE);
-
-	yaffs_GrossUnlock(dev);
-
-	if (ret >= 0)
-		ret = 0;
-
-	if (ret) {
-		ClearPageUptodate(pg);
-		SetPageError(pg);
-	} else {
-		SetPageUptodate(pg);
-		ClearPageError(pg);
-	}
+	ret = yaffs_readpage_fill(obj, pg);
 
-	flush_dcache_page(pg);
-	kunmap(pg);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 
 	T(YAFFS_TRACE_OS, (TSTR("yaffs_readpage_nolock done\n")));
 	return ret;
@@ -1057,6 +1202,56 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 	return ret;
 }
 
+#if (YAFFS_USE_PAGE_BATCHING > 0)
+/*
+ * Readahead. The pages are put into the page cache before taking the gross
+ * lock, since allocating there may recurse into writeback which needs it,
+ * then filled up to YAFFS_PAGE_BATCH at a time under one hold of the locks.
+ * Each page is still read chunk by chunk through yaffs_ReadDataFromFile();
+ * only the lock round trips are saved.
+ */
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_InodeToObject(mapping->host);
+	yaffs_Device *dev = obj->myDev;
+	struct page *batch[YAFFS_PAGE_BATCH];
+	struct page *pg;
+	int n = 0;
+	int i;
+
+	T(YAFFS_TRACE_OS, (TSTR("yaffs_readpages %u pages\n"), nr_pages));
+
+	while (!list_empty(pages)) {
+		pg = list_entry(pages->prev, struct page, lru);
+		list_del(&pg->lru);
+
+		if (!add_to_page_cache_lru(pg, mapping, pg->index, GFP_KERNEL))
+			batch[n++] = pg;
+		else
+			page_cache_release(pg);
+
+		if (n && (n == YAFFS_PAGE_BATCH || list_empty(pages))) {
+			yaffs_GrossLockShared(dev);
+			yaffs_GutsLock(dev);
+			for (i = 0; i < n; i++)
+				yaffs_readpage_fill(obj, batch[i]);
+			yaffs_GutsUnlock(dev);
+			yaffs_GrossUnlockShared(dev);
+
+			for (i = 0; i < n; i++) {
+				unlock_page(batch[i]);
+				page_cache_release(batch[i]);
+			}
+			n = 0;
+		}
+	}
+
+	T(YAFFS_TRACE_OS, (TSTR("yaffs_readpages done\n")));
+	return 0;
+}
+#endif
+
 /* writepage inspired by/stolen from smbfs */
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -1143,6 +1338,143 @@ static int yaffs_writepage(struct page *page)
 	return (nWritten == nBytes) ? 0 : -ENOSPC;
 }
 
+#if (YAFFS_USE_PAGE_BATCHING > 0)
+/*
+ * Writeback. write_cache_pages() hands us locked pages which are collected
+ * and then written up to YAFFS_PAGE_BATCH at a time under one hold of the
+ * gross lock, instead of taking it once per page as writepage does. Each
+ * page is still written chunk by chunk through yaffs_WriteDataToFile();
+ * only the lock round trips are saved.
+ *
+ * If the lock is busy, background writeback does not sit on a batch of
+ * locked pages waiting for it: all but the first page are redirtied and
+ * unlocked for a later pass. Integrity writeback must write them all, so
+ * it waits.
+ */
+struct yaffs_WritepagesBatch {
+	struct writeback_control *wbc;
+	struct page *pages[YAFFS_PAGE_BATCH];
+	int nPages;
+	int error;
+};
+
+static void yaffs_writepages_flush(struct address_space *mapping,
+				struct yaffs_WritepagesBatch *batch)
+{
+	struct inode *inode = mapping->host;
+	yaffs_Object *obj = yaffs_InodeToObject(inode);
+	yaffs_Device *dev = obj->myDev;
+	struct writeback_control *wbc = batch->wbc;
+	loff_t i_size = i_size_read(inode);
+	unsigned long end_index = i_size >> PAGE_CACHE_SHIFT;
+	struct page *page;
+	unsigned nBytes;
+	char *buffer;
+	int failed[YAFFS_PAGE_BATCH];
+	int i;
+
+	if (!batch->nPages)
+		return;
+
+	if (!yaffs_GrossTryLock(dev)) {
+		if (wbc->sync_mode == WB_SYNC_NONE) {
+			for (i = 1; i < batch->nPages; i++) {
+				page = batch->pages[i];
+				redirty_page_for_writepage(wbc, page);
+				unlock_page(page);
+				put_page(page);
+			}
+			batch->nPages = 1;
+		}
+		yaffs_GrossLock(dev);
+	}
+
+	for (i = 0; i < batch->nPages; i++) {
+		page = batch->pages[i];
+		failed[i] = 0;
+
+		if (page->index < end_index)
+			nBytes = PAGE_CACHE_SIZE;
+		else if (page->index > end_index)
+			nBytes = 0;
+		else
+			nBytes = i_size & (PAGE_CACHE_SIZE - 1);
+
+		if (nBytes != PAGE_CACHE_SIZE)
+			zero_user_segment(page, nBytes, PAGE_CACHE_SIZE);
+
+		/* Past EOF: nothing to write, the page is just cleaned */
+		if (!nBytes)
+			continue;
+
+		buffer = kmap(page);
+		if (yaffs_WriteDataToFile(obj, buffer,
+				page->index << PAGE_CACHE_SHIFT,
+				nBytes, 0) != nBytes) {
+			failed[i] = 1;
+			batch->error = -ENOSPC;
+		}
+		kunmap(page);
+	}
+
+	yaffs_MarkSuperBlockDirty(dev);
+
+	yaffs_GrossUnlock(dev);
+
+	for (i = 0; i < batch->nPages; i++) {
+		page = batch->pages[i];
+		if (failed[i]) {
+			/* Keep the data: flag the page and leave it dirty */
+			SetPageError(page);
+			redirty_page_for_writepage(wbc, page);
+			unlock_page(page);
+		} else {
+			set_page_writeback(page);
+			unlock_page(page);
+			end_page_writeback(page);
+		}
+		put_page(page);
+	}
+	batch->nPages = 0;
+}
+
+static int yaffs_writepages_collect(struct page *page,
+				struct writeback_control *wbc, void *data)
+{
+	struct yaffs_WritepagesBatch *batch = data;
+
+	get_page(page);
+	batch->pages[batch->nPages++] = page;
+
+	if (batch->nPages == YAFFS_PAGE_BATCH)
+		yaffs_writepages_flush(page->mapping, batch);
+
+	return batch->error;
+}
+
+static int yaffs_writepages(struct address_space *mapping,
+				struct writeback_control *wbc)
+{
+	struct yaffs_WritepagesBatch batch;
+	int ret;
+
+	batch.wbc = wbc;
+	batch.nPages = 0;
+	batch.error = 0;
+
+	ret = write_cache_pages(mapping, wbc, yaffs_writepages_collect, &batch);
+	yaffs_writepages_flush(mapping, &batch);
+
+	if (!ret)
+		ret = batch.error;
+	if (ret)
+		mapping_set_error(mapping, ret);
+
+	T(YAFFS_TRACE_OS, (TSTR("yaffs_writepages returning %d\n"), ret));
+	return ret;
+}
+#endif
+
 
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 static int yaffs_write_begin(struct file *filp, struct address_space *mapping,
@@ -1508,29 +1840,20 @@ static ssize_t yaffs_hold_space(struct file *f)
 
 	dev = obj->myDev;
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
 	nFreeChunks = yaffs_GetNumberOfFreeChunks(dev);
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 
 	return (nFreeChunks > 20) ? 1 : 0;
 }
 
 static void yaffs_release_space(struct file *f)
 {
-	yaffs_Object *obj;
-	yaffs_Device *dev;
-
-
-	obj = yaffs_DentryToObject(f->f_dentry);
-
-	dev = obj->myDev;
-
-	yaffs_GrossLock(dev);
-
-
-	yaffs_GrossUnlock(dev);
+	/* Nothing is actually held, so there is nothing to lock for. */
 }
 
 
@@ -1564,6 +1887,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 {
 	yaffs_Object *obj;
 	yaffs_Device *dev;
+	struct yaffs_ReaddirTask rt;
         struct yaffs_SearchContext *sc;
 	struct inode *inode = f->f_dentry->d_inode;
 	unsigned long offset, curoffs;
@@ -1575,9 +1899,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 	obj = yaffs_DentryToObject(f->f_dentry);
 	dev = obj->myDev;
 
-	yaffs_GrossLock(dev);
-
-	yaffs_DeviceToLC(dev)->readdirProcess = current;
+	yaffs_ReaddirLock(dev, &rt);
 
 	offset = f->f_pos;
 
@@ -1593,12 +1915,12 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 		T(YAFFS_TRACE_OS,
 			(TSTR("yaffs_readdir: entry . ino %d \n"),
 			(int)inode->i_ino));
-		yaffs_GrossUnlock(dev);
+		yaffs_ReaddirUnlock(dev, &rt);
 		if (filldir(dirent, ".", 1, offset, inode->i_ino, DT_DIR) < 0){
-			yaffs_GrossLock(dev);
+			yaffs_ReaddirLock(dev, &rt);
 			goto out;
 		}
-		yaffs_GrossLock(dev);
+		yaffs_ReaddirLock(dev, &rt);
 		offset++;
 		f->f_pos++;
 	}
@@ -1606,13 +1928,13 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 		T(YAFFS_TRACE_OS,
 			(TSTR("yaffs_readdir: entry .. ino %d \n"),
 			(int)f->f_dentry->d_parent->d_inode->i_ino));
-		yaffs_GrossUnlock(dev);
+		yaffs_ReaddirUnlock(dev, &rt);
 		if (filldir(dirent, "..", 2, offset,
 			f->f_dentry->d_parent->d_inode->i_ino, DT_DIR) < 0){
-			yaffs_GrossLock(dev);
+			yaffs_ReaddirLock(dev, &rt);
 			goto out;
 		}
-		yaffs_GrossLock(dev);
+		yaffs_ReaddirLock(dev, &rt);
 		offset++;
 		f->f_pos++;
 	}
@@ -1640,7 +1962,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 			  (TSTR("yaffs_readdir: %s inode %d\n"),
 			  name, yaffs_GetObjectInode(l)));
 
-                        yaffs_GrossUnlock(dev);
+                        yaffs_ReaddirUnlock(dev, &rt);
 
 			if (filldir(dirent,
 					name,
@@ -1648,11 +1970,11 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 					offset,
 					this_inode,
 					this_type) < 0){
-				yaffs_GrossLock(dev);
+				yaffs_ReaddirLock(dev, &rt);
 				goto out;
 			}
 
-                        yaffs_GrossLock(dev);
+                        yaffs_ReaddirLock(dev, &rt);
 
 			offset++;
 			f->f_pos++;
@@ -1662,8 +1984,7 @@ static int yaffs_readdir(struct file *f, void *dirent, filldir_t filldir)
 
 out:
 	yaffs_EndSearch(sc);
-	yaffs_DeviceToLC(dev)->readdirProcess = NULL;
-	yaffs_GrossUnlock(dev);
+	yaffs_ReaddirUnlock(dev, &rt);
 
 	return retVal;
 }
@@ -2155,7 +2476,8 @@ static int yaffs_statfs(struct super_block *sb, struct statfs *buf)
 
 	T(YAFFS_TRACE_OS, (TSTR("yaffs_statfs\n")));
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
 	buf->f_type = YAFFS_MAGIC;
 	buf->f_bsize = sb->s_blocksize;
@@ -2204,7 +2526,8 @@ static int yaffs_statfs(struct super_block *sb, struct statfs *buf)
 	buf->f_ffree = 0;
 	buf->f_bavail = buf->f_bfree;
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 	return 0;
 }
 
@@ -2307,6 +2630,9 @@ static int yaffs_do_sync_fs(struct super_block *sb,
 
 #ifdef YAFFS_COMPILE_BACKGROUND
 
+/* How long a dirty short op cache chunk may wait for the background thread */
+#define YAFFS_CACHE_FLUSH_INTERVAL	(5 * HZ)
+
 void yaffs_background_waker(unsigned long data)
 {
 	wake_up_process((struct task_struct *)data);
@@ -2319,6 +2645,7 @@ static int yaffs_BackgroundThread(void *data)
 	unsigned long now = jiffies;
 	unsigned long next_dir_update = now;
 	unsigned long next_gc = now;
+	unsigned long next_cache_flush = now;
 	unsigned long expires;
 	unsigned int urgency;
 
@@ -2343,10 +2670,18 @@ static int yaffs_BackgroundThread(void *data)
 		if(try_to_freeze())
 			continue;
 #endif
-		yaffs_GrossLock(dev);
-
 		now = jiffies;
 
+		/*
+		 * Background work is opportunistic: don't queue up behind
+		 * (or make foreground callers queue behind) a busy device,
+		 * just come back a little later.
+		 */
+		if(!yaffs_GrossTryLock(dev)){
+			expires = now + HZ/20 + 1;
+			goto sleep;
+		}
+
 		if(time_after(now, next_dir_update) && yaffs_bg_enable){
 			yaffs_UpdateDirtyDirectories(dev);
 			next_dir_update = now + HZ;
@@ -2368,14 +2703,32 @@ static int yaffs_BackgroundThread(void *data)
 				*/
 				next_gc = next_dir_update;
 		}
+
+		/*
+		 * Write dirty short op cache chunks back a while after they
+		 * were dirtied, or as soon as most of the cache is dirty,
+		 * so that they are not left in RAM until the next sync.
+		 */
+		if(dev->srNDirty > 0 && yaffs_bg_enable &&
+		   (time_after(now, next_cache_flush) ||
+		    dev->srNDirty > dev->param.nShortOpCaches / 2)){
+			T(YAFFS_TRACE_BACKGROUND,
+			  (TSTR("yaffs_background flushing %d cache chunks\n"),
+			  dev->srNDirty));
+			yaffs_FlushEntireDeviceCache(dev);
+			next_cache_flush = now + YAFFS_CACHE_FLUSH_INTERVAL;
+		} else if(dev->srNDirty == 0)
+			next_cache_flush = now + YAFFS_CACHE_FLUSH_INTERVAL;
 		yaffs_GrossUnlock(dev);
 #if 1
 		expires = next_dir_update;
 		if (time_before(next_gc,expires))
 			expires = next_gc;
+		if (dev->srNDirty > 0 && time_before(next_cache_flush,expires))
+			expires = next_cache_flush;
 		if(time_before(expires,now))
 			expires = now + HZ;
-
+sleep:
 		Y_INIT_TIMER(&timer);
 		timer.expires = expires+1;
 		timer.data = (unsigned long) current;
@@ -2501,13 +2854,15 @@ static struct inode *yaffs_iget(struct super_block *sb, unsigned long ino)
 	 * need to lock again.
 	 */
 
-	yaffs_GrossLock(dev);
+	yaffs_GrossLockShared(dev);
+	yaffs_GutsLock(dev);
 
 	obj = yaffs_FindObjectByNumber(dev, inode->i_ino);
 
 	yaffs_FillInodeFromObject(inode, obj);
 
-	yaffs_GrossUnlock(dev);
+	yaffs_GutsUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
 
 	unlock_new_inode(inode);
 	return inode;
@@ -2524,19 +2879,25 @@ static void yaffs_read_inode(struct inode *inode)
 
 	yaffs_Object *obj;
 	yaffs_Device *dev = yaffs_SuperToDevice(inode->i_sb);
+	int inReaddir;
 
 	T(YAFFS_TRACE_OS,
 		(TSTR("yaffs_read_inode for %d\n"), (int)inode->i_ino));
 
-	if(current != yaffs_DeviceToLC(dev)->readdirProcess)
-		yaffs_GrossLock(dev);
+	inReaddir = yaffs_InReaddir(dev);
+	if(!inReaddir){
+		yaffs_GrossLockShared(dev);
+		yaffs_GutsLock(dev);
+	}
 
 	obj = yaffs_FindObjectByNumber(dev, inode->i_ino);
 
 	yaffs_FillInodeFromObject(inode, obj);
 
-	if(current != yaffs_DeviceToLC(dev)->readdirProcess)
-		yaffs_GrossUnlock(dev);
+	if(!inReaddir){
+		yaffs_GutsUnlock(dev);
+		yaffs_GrossUnlockShared(dev);
+	}
 }
 
 #endif
@@ -2606,6 +2967,7 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int cache_size;
 	int tags_ecc_on;
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
@@ -2660,6 +3022,8 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->empty_lost_and_found_overridden=1;
 		} else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache-size=", 11))
+			options->cache_size = simple_strtoul(cur_opt + 11, NULL, 0);
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2916,7 +3280,8 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	param->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	param->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	param->nReservedBlocks = 5;
-	param->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	param->nShortOpCaches = (options.no_cache) ? 0 :
+		(options.cache_size ? options.cache_size : YAFFS_SHORT_OP_CACHES);
 	param->inbandTags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2954,6 +3319,14 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	param->alwaysCheckErased = 1;
 #endif
 
+#ifdef CONFIG_YAFFS_DISABLE_BLOCK_SUMMARY
+	param->disableSummary = 1;
+#endif
+
+#ifdef CONFIG_YAFFS_GC_GREEDY
+	param->gcGreedy = 1;
+#endif
+
 	if(options.empty_lost_and_found_overridden)
 		param->emptyLostAndFound = options.empty_lost_and_found;
 
@@ -3036,7 +3409,10 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
         YINIT_LIST_HEAD(&(yaffs_DeviceToLC(dev)->searchContexts));
         param->removeObjectCallback = yaffs_RemoveObjectCallback;
 
-	init_MUTEX(&(yaffs_DeviceToLC(dev)->grossLock));
+	init_rwsem(&(yaffs_DeviceToLC(dev)->grossLock));
+	mutex_init(&(yaffs_DeviceToLC(dev)->gutsLock));
+	YINIT_LIST_HEAD(&(yaffs_DeviceToLC(dev)->readdirTasks));
+	spin_lock_init(&(yaffs_DeviceToLC(dev)->readdirLock));
 
 	yaffs_GrossLock(dev);
 
@@ -3200,6 +3576,8 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "nShortOpCaches..... %d\n", dev->param.nShortOpCaches);
 	buf += sprintf(buf, "nReservedBlocks.... %d\n", dev->param.nReservedBlocks);
 	buf += sprintf(buf, "alwaysCheckErased.. %d\n", dev->param.alwaysCheckErased);
+	buf += sprintf(buf, "disableSummary..... %d\n", dev->param.disableSummary);
+	buf += sprintf(buf, "gcGreedy........... %d\n", dev->param.gcGreedy);
 
 	buf += sprintf(buf, "\n");
 
@@ -3207,6 +3585,36 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 }
 
 
+static __u32 yaffs_percent(__u32 part, __u32 whole)
+{
+	u64 x = (u64)part * 100;
+
+	if (!whole)
+		return 0;
+
+	do_div(x, whole);
+	return (__u32)x;
+}
+
+/*
+ * Chunks written to flash per chunk written on behalf of the file system.
+ * Summary pages and erased pages lost to sealing a block early count as
+ * flash writes.
+ */
+static char *yaffs_dump_write_amplification(char *buf, yaffs_Device * dev)
+{
+	__u32 wa = 100;
+
+	if (dev->nGCCopies < dev->nChunkWrites)
+		wa = yaffs_percent(dev->nChunkWrites + dev->nSummaryWrites +
+					dev->nSkippedChunks,
+				dev->nChunkWrites - dev->nGCCopies);
+
+	buf += sprintf(buf, "writeAmplification. %u.%02u\n", wa / 100, wa % 100);
+
+	return buf;
+}
+
 static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 {
 	buf += sprintf(buf, "nDataBytesPerChunk. %d\n", dev->nDataBytesPerChunk);
@@ -3217,12 +3625,17 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "nTnodes............ %d\n", dev->nTnodes);
 	buf += sprintf(buf, "nObjects........... %d\n", dev->nObjects);
+	buf += sprintf(buf, "nObjectBuckets..... %u\n", dev->nObjectBuckets);
 	buf += sprintf(buf, "nFreeChunks........ %d\n", dev->nFreeChunks);
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "nPageWrites........ %u\n", dev->nPageWrites);
 	buf += sprintf(buf, "nPageReads......... %u\n", dev->nPageReads);
 	buf += sprintf(buf, "nBlockErasures..... %u\n", dev->nBlockErasures);
+	buf += sprintf(buf, "nChunkWrites....... %u\n", dev->nChunkWrites);
 	buf += sprintf(buf, "nGCCopies.......... %u\n", dev->nGCCopies);
+	buf += sprintf(buf, "nColdCopies........ %u\n", dev->nColdCopies);
+	buf += sprintf(buf, "nSkippedChunks..... %u\n", dev->nSkippedChunks);
+	buf = yaffs_dump_write_amplification(buf, dev);
 	buf += sprintf(buf, "allGCs............. %u\n", dev->allGCs);
 	buf += sprintf(buf, "passiveGCs......... %u\n", dev->passiveGCs);
 	buf += sprintf(buf, "oldestDirtyGCs..... %u\n", dev->oldestDirtyGCs);
@@ -3235,9 +3648,16 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "tagsEccFixed....... %u\n", dev->tagsEccFixed);
 	buf += sprintf(buf, "tagsEccUnfixed..... %u\n", dev->tagsEccUnfixed);
 	buf += sprintf(buf, "cacheHits.......... %u\n", dev->cacheHits);
+	buf += sprintf(buf, "cacheLookups....... %u\n", dev->cacheLookups);
+	buf += sprintf(buf, "cacheHitPercent.... %u\n",
+		yaffs_percent(dev->cacheHits, dev->cacheLookups));
+	buf += sprintf(buf, "cacheDirty......... %d\n", dev->srNDirty);
+	buf += sprintf(buf, "cacheWritebacks.... %u\n", dev->cacheWritebacks);
 	buf += sprintf(buf, "nDeletedFiles...... %u\n", dev->nDeletedFiles);
 	buf += sprintf(buf, "nUnlinkedFiles..... %u\n", dev->nUnlinkedFiles);
 	buf += sprintf(buf, "refreshCount....... %u\n", dev->refreshCount);
+	buf += sprintf(buf, "nSummaryWrites..... %u\n", dev->nSummaryWrites);
+	buf += sprintf(buf, "nSummaryScans...... %u\n", dev->nSummaryScans);
 	buf +=
 	    sprintf(buf, "nBackgroudDeletions %u\n", dev->nBackgroundDeletions);
 
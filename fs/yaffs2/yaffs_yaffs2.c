@@ -21,6 +21,7 @@
 #include "yaffs_nand.h"
 #include "yaffs_getblockinfo.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 /*
  * Checkpoints are really no benefit on very small partitions.
@@ -553,7 +554,7 @@ static int yaffs2_WriteCheckpointObjects(yaffs_Device *dev)
 	 * dumping them to the checkpointing stream.
 	 */
 
-	for (i = 0; ok &&  i <  YAFFS_NOBJECT_BUCKETS; i++) {
+	for (i = 0; ok &&  i <  dev->nObjectBuckets; i++) {
 		ylist_for_each(lh, &dev->objectBucket[i].list) {
 			if (lh) {
 				obj = ylist_entry(lh, yaffs_Object, hashLink);
@@ -673,8 +674,11 @@ static int yaffs2_WriteCheckpointData(yaffs_Device *dev)
 		ok = 0;
 	}
 
-	if (ok)
+	if (ok) {
+		/* The checkpoint only has room for one allocation block */
+		yaffs_SkipRestOfColdBlock(dev);
 		ok = yaffs2_CheckpointOpen(dev, 1);
+	}
 
 	if (ok) {
 		T(YAFFS_TRACE_CHECKPOINT, (TSTR("write checkpoint validity" TENDSTR)));
@@ -936,6 +940,7 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 	int fileSize;
 	int isShrink;
 	int foundChunksInBlock;
+	int summaryAvailable;
 	int equivalentObjectId;
 	int alloc_failed = 0;
 
@@ -1063,6 +1068,10 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 
 		deleted = 0;
 
+		/* A sealed block's summary saves reading the tags of each chunk */
+		summaryAvailable = (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+				yaffs_SummaryRead(dev, blk, bi));
+
 		/* For each chunk in each block that needs scanning.... */
 		foundChunksInBlock = 0;
 		for (c = dev->param.nChunksPerBlock - 1;
@@ -1075,8 +1084,11 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 
 			chunk = blk * dev->param.nChunksPerBlock + c;
 
-			result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk, NULL,
-							&tags);
+			if (summaryAvailable)
+				result = yaffs_SummaryFetchTags(dev, blk, c, &tags);
+			else
+				result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk,
+							NULL, &tags);
 
 			/* Let's have a good look at this chunk... */
 
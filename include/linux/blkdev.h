@@ -195,7 +195,7 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_WRITE_LATENCY)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
@@ -329,6 +329,17 @@ struct queue_limits {
 	signed char		discard_zeroes_data;
 };
 
+/*
+ * Per-queue write completion latency, split into async (index 0) and
+ * sync (index 1) writes.  Updated under the queue lock.
+ */
+struct blk_write_stats {
+	unsigned long		count;
+	u64			total_ns;	/* queue + service time */
+	u64			max_ns;
+	u64			service_ns;	/* time spent in the driver */
+};
+
 struct request_queue
 {
 	/*
@@ -418,6 +429,16 @@ struct request_queue
 	unsigned int		nr_sorted;
 	unsigned int		in_flight[2];
 
+	/*
+	 * sync writes that skipped the elevator
+	 */
+	unsigned int		sync_write_boost;
+	unsigned long		nr_boosted;
+	struct request		*boost_last;	/* may be merged into */
+#ifdef CONFIG_BLK_WRITE_LATENCY
+	struct blk_write_stats	write_stats[2];
+#endif
+
 	unsigned int		rq_timeout;
 	struct timer_list	timeout;
 	struct list_head	timeout_list;
@@ -647,6 +668,15 @@ static inline bool rw_is_sync(unsigned int rw_flags)
 	return !(rw_flags & REQ_RW) || (rw_flags & REQ_RW_SYNC);
 }
 
+/*
+ * Requests in the idle class, either set explicitly or inherited from a
+ * background task, are served after foreground ones by deadline and flash.
+ */
+static inline bool rq_is_background(struct request *rq)
+{
+	return IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) == IOPRIO_CLASS_IDLE;
+}
+
 static inline bool rq_is_sync(struct request *rq)
 {
 	return rw_is_sync(rq->cmd_flags);
@@ -1213,7 +1243,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_WRITE_LATENCY)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
@@ -0,0 +1,28 @@
+#ifndef _LINUX_BOOT_PREFETCH_H
+#define _LINUX_BOOT_PREFETCH_H
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+struct file;
+
+#ifdef CONFIG_BOOT_PREFETCH
+extern int boot_prefetch_recording;
+extern void __boot_prefetch_record(struct file *file, pgoff_t index,
+				   unsigned long nr);
+
+/* Note pages of @file being read or faulted in, if a boot is recorded */
+static inline void boot_prefetch_record(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+	if (unlikely(boot_prefetch_recording))
+		__boot_prefetch_record(file, index, nr);
+}
+#else
+static inline void boot_prefetch_record(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_BOOT_PREFETCH_H */
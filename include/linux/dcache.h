@@ -393,5 +393,6 @@ extern struct vfsmount *lookup_mnt(struct path *);
 extern struct dentry *lookup_create(struct nameidata *nd, int is_dir);
 
 extern int sysctl_vfs_cache_pressure;
+extern int sysctl_negative_dentry_retain;
 
 #endif	/* __LINUX_DCACHE_H */
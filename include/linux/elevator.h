@@ -80,6 +80,7 @@ struct elevator_type
 	struct elv_fs_entry *elevator_attrs;
 	char elevator_name[ELV_NAME_MAX];
 	struct module *elevator_owner;
+	bool sync_write_boost;		/* sync writes may bypass it */
 };
 
 /*
@@ -899,6 +899,11 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	unsigned int ra_issued;		/* # of pages read ahead */
+	unsigned int ra_hits;		/* # of those that were used */
+	unsigned int ra_last;		/* # read in the last window, not
+					   yet in ra_issued */
 };
 
 /*
@@ -1345,9 +1350,15 @@ struct super_block {
 	struct list_head	s_inodes;	/* all inodes */
 	struct hlist_head	s_anon;		/* anonymous dentries for (nfs) exporting */
 	struct list_head	s_files;
-	/* s_dentry_lru and s_nr_dentry_unused are protected by dcache_lock */
+	/* s_dentry_lru and s_nr_dentry_* are protected by dcache_lock */
 	struct list_head	s_dentry_lru;	/* unused dentry lru */
 	int			s_nr_dentry_unused;	/* # of dentry on lru */
+	int			s_nr_dentry_negative;	/* # of negative ones */
+
+	/* lookup statistics, not locked */
+	unsigned long		s_lookup_hits;		/* positive dcache hits */
+	unsigned long		s_lookup_neg_hits;	/* negative dcache hits */
+	unsigned long		s_lookup_misses;	/* calls to ->lookup() */
 
 	struct block_device	*s_bdev;
 	struct backing_dev_info *s_bdi;
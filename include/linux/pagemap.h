@@ -452,4 +452,17 @@ static inline int add_to_page_cache(struct page *page,
 	return error;
 }
 
+/*
+ * Called for a page cache page about to be read through @ra, so readahead
+ * gets the credit if it brought the page in.
+ */
+static inline void page_cache_ra_used(struct file_ra_state *ra,
+				      struct page *page)
+{
+	if (PagePrefetched(page) && TestClearPagePrefetched(page)) {
+		ra->ra_hits++;
+		count_vm_event(READAHEAD_HIT);
+	}
+}
+
 #endif /* _LINUX_PAGEMAP_H */
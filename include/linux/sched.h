@@ -176,6 +176,11 @@ print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 }
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+extern void proc_sched_latency_show(struct task_struct *p, struct seq_file *m);
+extern void proc_sched_latency_reset(struct task_struct *p);
+#endif
+
 /*
  * Task state bitmask. NOTE! These bits are also
  * encoded in fs/proc/array.c: get_task_state().
@@ -711,6 +716,15 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Run queue latency is bucketed by log2 of the delay in 1024ns units:
+ * bucket 0 holds delays below ~1us, bucket n holds [2^(n-1), 2^n) units
+ * and the last bucket holds everything from ~16.7ms upwards.
+ */
+#define SCHED_LAT_HIST_BUCKETS	16
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
 	/* cumulative counters */
@@ -724,6 +738,10 @@ struct sched_info {
 	/* BKL stats */
 	unsigned int bkl_count;
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* wakeup/preemption to run latency histogram */
+	unsigned long lat_hist[SCHED_LAT_HIST_BUCKETS];
+#endif
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
 
@@ -2034,6 +2052,7 @@ extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
 extern int can_nice(const struct task_struct *p, const int nice);
+extern int task_sched_background(struct task_struct *p);
 extern int task_curr(const struct task_struct *p);
 extern int idle_cpu(int cpu);
 extern int sched_setscheduler(struct task_struct *, int, struct sched_param *);
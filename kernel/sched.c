@@ -4630,6 +4630,28 @@ int task_nice(const struct task_struct *p)
 }
 EXPORT_SYMBOL(task_nice);
 
+/**
+ * task_sched_background - does the scheduler treat a task as background?
+ * @p: the task in question.
+ *
+ * True for SCHED_IDLE tasks and for tasks in a cpu cgroup that was given
+ * less than the default share, such as Android's bg_non_interactive.
+ * The block layer uses this to derive an I/O priority.
+ */
+int task_sched_background(struct task_struct *p)
+{
+	int ret = 0;
+
+	if (p->policy == SCHED_IDLE)
+		return 1;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	rcu_read_lock();
+	ret = task_group(p)->shares < NICE_0_LOAD;
+	rcu_read_unlock();
+#endif
+	return ret;
+}
+
 /**
  * idle_cpu - is a given cpu idle currently?
  * @cpu: the processor in question.
@@ -68,6 +68,7 @@
 #include <linux/bootmem.h>
 #include <linux/ftrace.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
 
 #include <asm/tlb.h>
 #include <asm/unistd.h>
@@ -170,6 +171,7 @@ struct global_rq {
 	int noc; /* num_online_cpus stored and updated when it changes */
 	u64 niffies; /* Nanosecond jiffies */
 	unsigned long last_jiffy; /* Last jiffy we updated niffies */
+	u64 dl_hint; /* No queued task has an earlier deadline than this */
 
 	raw_spinlock_t iso_lock;
 	int iso_ticks;
@@ -624,8 +626,11 @@ static inline int task_queued(struct task_struct *p)
 static void dequeue_task(struct task_struct *p)
 {
 	list_del_init(&p->run_list);
-	if (list_empty(grq.queue + p->prio))
+	if (list_empty(grq.queue + p->prio)) {
 		__clear_bit(p->prio, grq.prio_bitmap);
+		if (find_first_bit(grq.prio_bitmap, PRIO_LIMIT) >= PRIO_LIMIT)
+			grq.dl_hint = ~0ULL;
+	}
 }
 
 /*
@@ -662,6 +667,8 @@ static void enqueue_task(struct task_struct *p)
 	}
 	__set_bit(p->prio, grq.prio_bitmap);
 	list_add_tail(&p->run_list, grq.queue + p->prio);
+	if (deadline_before(p->deadline, grq.dl_hint))
+		grq.dl_hint = p->deadline;
 	sched_info_queued(p);
 }
 
@@ -2819,6 +2826,22 @@ out:
 	return edt;
 }
 
+/*
+ * grq.dl_hint is only ever lowered while tasks are queued so it is a cheap
+ * lower bound of every queued deadline. A SCHED_NORMAL task whose deadline
+ * is strictly earlier than that, with nothing of better priority queued,
+ * is what earliest_deadline_task() would pick anyway, so it can keep the
+ * CPU without being requeued and without an O(n) scan under grq lock.
+ */
+static inline int prev_earliest_deadline(struct task_struct *prev)
+{
+	if (prev->prio != NORMAL_PRIO || idleprio_task(prev) || iso_task(prev))
+		return 0;
+	if (find_first_bit(grq.prio_bitmap, PRIO_LIMIT) < NORMAL_PRIO)
+		return 0;
+	return deadline_before(prev->deadline, grq.dl_hint);
+}
+
 /*
  * Print scheduling while atomic bug:
  */
@@ -2943,13 +2966,17 @@ need_resched_nonpreemptible:
 		if (needs_other_cpu(prev, cpu))
 			resched_suitable_idle(prev);
 		else if (!deactivate) {
-			if (!queued_notrunning()) {
+			if (!queued_notrunning() ||
+			    prev_earliest_deadline(prev)) {
 				/*
 				* We now know prev is the only thing that is
-				* awaiting CPU so we can bypass rechecking for
-				* the earliest deadline task and just run it
-				* again.
+				* awaiting CPU, or would be picked first anyway,
+				* so we can bypass rechecking for the earliest
+				* deadline task and just run it again. Its
+				* deadline and time_slice may have been renewed
+				* so update the rq copies used by try_preempt.
 				*/
+				set_rq_task(rq, prev);
 				grq_unlock_irq();
 				goto rerun_prev_unlocked;
 			} else
@@ -3721,6 +3748,17 @@ int task_nice(const struct task_struct *p)
 }
 EXPORT_SYMBOL_GPL(task_nice);
 
+/**
+ * task_sched_background - does the scheduler treat a task as background?
+ * @p: the task in question.
+ *
+ * BFS has no cpu cgroups, so this is just SCHED_IDLEPRIO.
+ */
+int task_sched_background(struct task_struct *p)
+{
+	return idleprio_task(p);
+}
+
 /**
  * idle_cpu - is a given cpu idle currently?
  * @cpu: the processor in question.
@@ -6936,6 +6974,7 @@ void __init sched_init(void)
 	grq.nr_running = grq.nr_uninterruptible = grq.nr_switches = 0;
 	grq.niffies = 0;
 	grq.last_jiffy = jiffies;
+	grq.dl_hint = ~0ULL;
 	raw_spin_lock_init(&grq.iso_lock);
 	grq.iso_ticks = grq.iso_refractory = 0;
 	grq.noc = 1;
@@ -7253,6 +7292,91 @@ void proc_sched_set_task(struct task_struct *p)
 {}
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static void sched_lat_hist_show(struct seq_file *m, unsigned long *hist)
+{
+	int i;
+
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++) {
+		unsigned long lo = i ? (1UL << (i - 1)) * 1024 / 1000 : 0;
+
+		if (i == SCHED_LAT_HIST_BUCKETS - 1)
+			seq_printf(m, "%6lu+ us\t%lu\n", lo, hist[i]);
+		else
+			seq_printf(m, "%6lu- us\t%lu\n", lo, hist[i]);
+	}
+}
+
+void proc_sched_latency_show(struct task_struct *p, struct seq_file *m)
+{
+	seq_printf(m, "%s (%d) run_delay %llu ns pcount %lu\n", p->comm,
+		   p->pid, p->sched_info.run_delay, p->sched_info.pcount);
+	sched_lat_hist_show(m, p->sched_info.lat_hist);
+}
+
+void proc_sched_latency_reset(struct task_struct *p)
+{
+	memset(p->sched_info.lat_hist, 0, sizeof(p->sched_info.lat_hist));
+}
+
+static int sched_latency_show(struct seq_file *m, void *v)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		seq_printf(m, "cpu%d run_delay %llu ns pcount %lu\n", cpu,
+			   rq->rq_sched_info.run_delay,
+			   rq->rq_sched_info.pcount);
+		sched_lat_hist_show(m, rq->rq_sched_info.lat_hist);
+	}
+	return 0;
+}
+
+static ssize_t
+sched_latency_write(struct file *filp, const char __user *ubuf,
+		    size_t cnt, loff_t *ppos)
+{
+	unsigned long flags;
+	int cpu;
+
+	grq_lock_irqsave(&flags);
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		memset(rq->rq_sched_info.lat_hist, 0,
+		       sizeof(rq->rq_sched_info.lat_hist));
+	}
+	grq_unlock_irqrestore(&flags);
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static int sched_latency_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_latency_show, NULL);
+}
+
+static const struct file_operations sched_latency_fops = {
+	.open		= sched_latency_open,
+	.write		= sched_latency_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_latency_init_debug(void)
+{
+	debugfs_create_file("sched_latency", 0644, NULL, NULL,
+			&sched_latency_fops);
+
+	return 0;
+}
+late_initcall(sched_latency_init_debug);
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 /* No RCU torture test support */
 void synchronize_sched_expedited(void)
 {
@@ -1,3 +1,16 @@
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static inline void
+sched_lat_hist_add(struct sched_info *si, unsigned long long delta)
+{
+	int bucket = fls64(delta >> 10);
+
+	if (bucket >= SCHED_LAT_HIST_BUCKETS)
+		bucket = SCHED_LAT_HIST_BUCKETS - 1;
+	si->lat_hist[bucket]++;
+}
+#else
+# define sched_lat_hist_add(si, delta)	do { } while (0)
+#endif
 
 #ifdef CONFIG_SCHEDSTATS
 /*
@@ -113,6 +126,7 @@ rq_sched_info_arrive(struct rq *rq, unsigned long long delta)
 	if (rq) {
 		rq->rq_sched_info.run_delay += delta;
 		rq->rq_sched_info.pcount++;
+		sched_lat_hist_add(&rq->rq_sched_info, delta);
 	}
 }
 
@@ -198,6 +212,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
+	sched_lat_hist_add(&t->sched_info, delta);
 
 	rq_sched_info_arrive(task_rq(t), delta);
 }
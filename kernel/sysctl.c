@@ -1412,6 +1412,14 @@ static struct ctl_table fs_table[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "negative-dentry-retain",
+		.data		= &sysctl_negative_dentry_retain,
+		.maxlen		= sizeof(sysctl_negative_dentry_retain),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "overflowuid",
 		.data		= &fs_overflowuid,
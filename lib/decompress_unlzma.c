@@ -34,6 +34,10 @@
 #else
 #include <linux/decompress/unlzma.h>
 #include <linux/slab.h>
+#include <linux/module.h>
+#ifdef CONFIG_DECOMPRESS_LZMA_RUNTIME
+#define INIT
+#endif
 #endif /* STATIC */
 
 #include <linux/decompress/mm.h>
@@ -653,6 +657,10 @@ exit_0:
 	return ret;
 }
 
+#if !defined(PREBOOT) && defined(CONFIG_DECOMPRESS_LZMA_RUNTIME)
+EXPORT_SYMBOL(unlzma);
+#endif
+
 #ifdef PREBOOT
 STATIC int INIT decompress(unsigned char *buf, int in_len,
 			      int(*fill)(void*, unsigned int),
@@ -0,0 +1,384 @@
+/*
+ * mm/boot_prefetch.c - record and replay the file pages touched at boot.
+ *
+ * While recording, every page read through the page cache or faulted in
+ * from a file mapping is noted against its file.  Reading
+ * /proc/boot_prefetch then gives one line per run of pages:
+ *
+ *	<path> <first page> <number of pages>
+ *
+ * with the files in the order they were first touched and the runs of
+ * each file in ascending order.  Small holes between runs are swallowed,
+ * one larger read being cheaper than two small ones.
+ *
+ * Writing such lines back to /proc/boot_prefetch, typically from init
+ * before the apps are started, reads each run into the page cache with a
+ * single readahead request.  Files that no longer exist are skipped.
+ *
+ * Writing "record" starts a new recording and "stop" ends it.  Booting
+ * with boot_prefetch=record starts recording before init runs.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/bitmap.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/pagemap.h>
+#include <linux/boot_prefetch.h>
+#include <asm/uaccess.h>
+
+#define BP_HASH_BITS	8
+#define BP_MAX_FILES	4096
+#define BP_MAX_PAGES	65536		/* recorded per file */
+#define BP_MAX_BYTES	(1024 * 1024)	/* for the whole recording */
+#define BP_MERGE_GAP	8		/* pages */
+
+struct bp_file {
+	struct hlist_node hash;
+	struct list_head list;
+	struct super_block *sb;
+	unsigned long ino;
+	char *path;			/* NULL if it can't be replayed */
+	unsigned long *pages;
+	pgoff_t npages;			/* bits in pages */
+};
+
+int boot_prefetch_recording __read_mostly;
+
+static DEFINE_MUTEX(bp_mutex);
+static struct hlist_head bp_hash[1 << BP_HASH_BITS];
+static LIST_HEAD(bp_files);
+static int bp_nr_files;
+static size_t bp_bytes;
+
+static int __init boot_prefetch_setup(char *str)
+{
+	if (!strcmp(str, "record"))
+		boot_prefetch_recording = 1;
+	return 1;
+}
+__setup("boot_prefetch=", boot_prefetch_setup);
+
+static struct hlist_head *bp_head(struct inode *inode)
+{
+	return bp_hash + hash_long((unsigned long)inode->i_sb ^ inode->i_ino,
+				   BP_HASH_BITS);
+}
+
+static struct bp_file *bp_find(struct inode *inode)
+{
+	struct bp_file *bf;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(bf, pos, bp_head(inode), hash)
+		if (bf->sb == inode->i_sb && bf->ino == inode->i_ino)
+			return bf;
+	return NULL;
+}
+
+static int bp_full(void)
+{
+	printk(KERN_INFO "boot_prefetch: recording full, stopped\n");
+	boot_prefetch_recording = 0;
+	return -ENOSPC;
+}
+
+/* Charge @bytes to the recording, which stops once it gets too big */
+static int bp_charge(size_t bytes)
+{
+	if (bp_bytes + bytes > BP_MAX_BYTES)
+		return bp_full();
+	bp_bytes += bytes;
+	return 0;
+}
+
+/*
+ * Files that can't be named, unlinked ones for instance, are still
+ * added so that they are looked up only once, but never recorded.
+ */
+static struct bp_file *bp_add(struct file *file)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct bp_file *bf;
+	char *buf, *p;
+
+	if (bp_nr_files >= BP_MAX_FILES) {
+		bp_full();
+		return NULL;
+	}
+	if (bp_charge(sizeof(*bf)))
+		return NULL;
+	bf = kzalloc(sizeof(*bf), GFP_NOFS);
+	if (!bf)
+		return NULL;
+	bf->sb = inode->i_sb;
+	bf->ino = inode->i_ino;
+
+	buf = (char *)__get_free_page(GFP_NOFS);
+	if (buf) {
+		p = d_path(&file->f_path, buf, PAGE_SIZE);
+		if (!IS_ERR(p) && *p == '/' &&
+		    !d_unlinked(file->f_path.dentry) &&
+		    !bp_charge(strlen(p) + 1))
+			bf->path = kstrdup(p, GFP_NOFS);
+		free_page((unsigned long)buf);
+	}
+
+	hlist_add_head(&bf->hash, bp_head(inode));
+	list_add_tail(&bf->list, &bp_files);
+	bp_nr_files++;
+	return bf;
+}
+
+static int bp_grow(struct bp_file *bf, pgoff_t npages)
+{
+	unsigned long *pages;
+	size_t old, new;
+
+	npages = max_t(pgoff_t, npages, bf->npages * 2);
+	npages = min_t(pgoff_t, ALIGN(npages, BITS_PER_LONG), BP_MAX_PAGES);
+	old = BITS_TO_LONGS(bf->npages) * sizeof(long);
+	new = BITS_TO_LONGS(npages) * sizeof(long);
+
+	if (bp_charge(new - old))
+		return -ENOSPC;
+	pages = krealloc(bf->pages, new, GFP_NOFS);
+	if (!pages) {
+		bp_bytes -= new - old;
+		return -ENOMEM;
+	}
+	memset((char *)pages + old, 0, new - old);
+	bf->pages = pages;
+	bf->npages = npages;
+	return 0;
+}
+
+void __boot_prefetch_record(struct file *file, pgoff_t index,
+			    unsigned long nr)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct bp_file *bf;
+	pgoff_t end;
+
+	if (!S_ISREG(inode->i_mode))
+		return;
+	end = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	end = min_t(pgoff_t, end, BP_MAX_PAGES);
+	if (index >= end)
+		return;
+	end = min_t(pgoff_t, end, index + nr);
+
+	mutex_lock(&bp_mutex);
+	if (!boot_prefetch_recording)
+		goto out;
+
+	bf = bp_find(inode);
+	if (!bf)
+		bf = bp_add(file);
+	if (!bf || !bf->path)
+		goto out;
+	if (end > bf->npages && bp_grow(bf, end))
+		goto out;
+	bitmap_set(bf->pages, index, end - index);
+out:
+	mutex_unlock(&bp_mutex);
+}
+
+/* Must be called with bp_mutex held */
+static void bp_clear(void)
+{
+	struct bp_file *bf, *tmp;
+
+	list_for_each_entry_safe(bf, tmp, &bp_files, list) {
+		hlist_del(&bf->hash);
+		list_del(&bf->list);
+		kfree(bf->pages);
+		kfree(bf->path);
+		kfree(bf);
+	}
+	bp_nr_files = 0;
+	bp_bytes = 0;
+}
+
+static void *bp_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&bp_mutex);
+	return seq_list_start(&bp_files, *pos);
+}
+
+static void *bp_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &bp_files, pos);
+}
+
+static void bp_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&bp_mutex);
+}
+
+static int bp_seq_show(struct seq_file *m, void *v)
+{
+	struct bp_file *bf = list_entry(v, struct bp_file, list);
+	unsigned long start, end, next;
+
+	if (!bf->path)
+		return 0;
+
+	start = find_first_bit(bf->pages, bf->npages);
+	while (start < bf->npages) {
+		end = find_next_zero_bit(bf->pages, bf->npages, start);
+		for (;;) {
+			next = find_next_bit(bf->pages, bf->npages, end);
+			if (next >= bf->npages || next - end > BP_MERGE_GAP)
+				break;
+			end = find_next_zero_bit(bf->pages, bf->npages, next);
+		}
+
+		seq_escape(m, bf->path, " \t\n\\");
+		seq_printf(m, " %lu %lu\n", start, end - start);
+		start = next;
+	}
+	return 0;
+}
+
+static const struct seq_operations bp_seq_ops = {
+	.start	= bp_seq_start,
+	.next	= bp_seq_next,
+	.stop	= bp_seq_stop,
+	.show	= bp_seq_show,
+};
+
+static int bp_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &bp_seq_ops);
+}
+
+/* Undo the \ooo escapes seq_escape() put in the path */
+static void bp_unescape(char *s)
+{
+	char *d = s;
+
+	while (*s) {
+		if (s[0] == '\\' &&
+		    s[1] >= '0' && s[1] <= '3' &&
+		    s[2] >= '0' && s[2] <= '7' &&
+		    s[3] >= '0' && s[3] <= '7') {
+			*d++ = (s[1] - '0') << 6 | (s[2] - '0') << 3 |
+				(s[3] - '0');
+			s += 4;
+		} else
+			*d++ = *s++;
+	}
+	*d = '\0';
+}
+
+static int bp_replay(char *line)
+{
+	unsigned long start, nr;
+	struct file *filp;
+	char *p;
+
+	p = strrchr(line, ' ');
+	if (!p || strict_strtoul(p + 1, 10, &nr))
+		return -EINVAL;
+	*p = '\0';
+	p = strrchr(line, ' ');
+	if (!p || strict_strtoul(p + 1, 10, &start))
+		return -EINVAL;
+	*p = '\0';
+	bp_unescape(line);
+
+	filp = filp_open(line, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return 0;	/* gone since the recording was made */
+	force_page_cache_readahead(filp->f_mapping, filp, start, nr);
+	filp_close(filp, NULL);
+	return 0;
+}
+
+static int bp_do_line(char *line)
+{
+	line = strstrip(line);
+	if (!*line)
+		return 0;
+
+	if (!strcmp(line, "record")) {
+		mutex_lock(&bp_mutex);
+		bp_clear();
+		boot_prefetch_recording = 1;
+		mutex_unlock(&bp_mutex);
+		return 0;
+	}
+	if (!strcmp(line, "stop")) {
+		boot_prefetch_recording = 0;
+		return 0;
+	}
+	return bp_replay(line);
+}
+
+/*
+ * A line cut off by the end of the buffer isn't consumed, the writer
+ * passes it again at the start of its next write.
+ */
+static ssize_t bp_write(struct file *file, const char __user *ubuf,
+			size_t count, loff_t *ppos)
+{
+	size_t len = min_t(size_t, count, PAGE_SIZE - 1);
+	char *buf, *line, *nl;
+	ssize_t done = 0;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, len)) {
+		done = -EFAULT;
+		goto out;
+	}
+	buf[len] = '\0';
+
+	for (line = buf; line < buf + len; line = nl + 1) {
+		nl = strchr(line, '\n');
+		if (!nl) {
+			if (line != buf)
+				break;
+			nl = buf + len;
+		}
+		*nl = '\0';
+
+		err = bp_do_line(line);
+		if (err) {
+			if (!done)
+				done = err;
+			break;
+		}
+		done = min_t(size_t, nl + 1 - buf, len);
+	}
+out:
+	free_page((unsigned long)buf);
+	return done;
+}
+
+static const struct file_operations bp_fops = {
+	.open		= bp_open,
+	.read		= seq_read,
+	.write		= bp_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init boot_prefetch_init(void)
+{
+	proc_create("boot_prefetch", S_IRUSR | S_IWUSR, NULL, &bp_fops);
+	return 0;
+}
+module_init(boot_prefetch_init);
@@ -34,6 +34,7 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
+#include <linux/boot_prefetch.h>
 #include "internal.h"
 
 /*
@@ -127,6 +128,10 @@ void __remove_from_page_cache(struct page *page)
 		__dec_zone_page_state(page, NR_SHMEM);
 	BUG_ON(page_mapped(page));
 
+	/* Read ahead for nothing */
+	if (PagePrefetched(page) && TestClearPagePrefetched(page))
+		__count_vm_event(READAHEAD_WASTE);
+
 	/*
 	 * Some filesystems seem to re-dirty the page even after
 	 * the VM has canceled the dirty bit (eg ext3 journaling).
@@ -982,6 +987,8 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE-1) >> PAGE_CACHE_SHIFT;
 	offset = *ppos & ~PAGE_CACHE_MASK;
 
+	boot_prefetch_record(filp, index, last_index - index);
+
 	for (;;) {
 		struct page *page;
 		pgoff_t end_index;
@@ -1059,6 +1066,7 @@ page_ok:
 		 */
 		if (prev_index != index || offset != prev_offset)
 			mark_page_accessed(page);
+		page_cache_ra_used(ra, page);
 		prev_index = index;
 
 		/*
@@ -1467,12 +1475,12 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = ra_adaptive_max(ra);
 	if (ra_pages) {
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
 		ra->async_size = 0;
-		ra_submit(ra, mapping, file);
+		ra_submit(ra, mapping, file, offset, 1);
 	}
 }
 
@@ -1526,6 +1534,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	boot_prefetch_record(file, offset, 1);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
@@ -1573,6 +1583,7 @@ retry_find:
 		return VM_FAULT_SIGBUS;
 	}
 
+	page_cache_ra_used(ra, page);
 	ra->prev_pos = (loff_t)offset << PAGE_CACHE_SHIFT;
 	vmf->page = page;
 	return ret | VM_FAULT_LOCKED;
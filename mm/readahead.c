@@ -18,6 +18,11 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+/* Readahead feedback is averaged over this many full windows */
+#define RA_FEEDBACK_WINDOWS	8
+/* and never shrinks the window below this many pages */
+#define RA_MIN_PAGES		4
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -133,27 +138,70 @@ out:
 	return ret;
 }
 
+/*
+ * Count the pages in [start, end) that are in the page cache and still
+ * marked as read ahead.
+ */
+static unsigned long count_prefetched(struct address_space *mapping,
+			pgoff_t start, pgoff_t end)
+{
+	struct pagevec pvec;
+	unsigned long count = 0;
+	int i, nr;
+
+	pagevec_init(&pvec, 0);
+	while (start < end) {
+		nr = pagevec_lookup(&pvec, mapping, start,
+				min_t(pgoff_t, end - start, PAGEVEC_SIZE));
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++) {
+			struct page *page = pvec.pages[i];
+
+			if (page->index >= end)
+				break;
+			if (PagePrefetched(page))
+				count++;
+		}
+		start = pvec.pages[nr - 1]->index + 1;
+		pagevec_release(&pvec);
+	}
+	return count;
+}
+
 /*
  * __do_page_cache_readahead() actually reads a chunk of disk.  It allocates all
  * the pages first, then submits them all for I/O. This avoids the very bad
  * behaviour which would occur if page allocations are causing VM writeback.
  * We really don't want to intermingle reads and writes like that.
  *
+ * If @prefetched is given, the pages outside of the @demand_size pages at
+ * @demand, which the reader is waiting for, are marked PG_prefetched, and
+ * @prefetched is set to the number of them that made it into the page
+ * cache.  That can be fewer than were allocated, as ->readpages is free to
+ * drop pages from the list, and it only counts the pages it put in their
+ * place if it marked them PG_prefetched.
+ *
  * Returns the number of pages requested, or the maximum amount of I/O allowed.
  */
 static int
 __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read,
-			unsigned long lookahead_size)
+			unsigned long lookahead_size, pgoff_t demand,
+			unsigned long demand_size, unsigned long *prefetched)
 {
 	struct inode *inode = mapping->host;
 	struct page *page;
 	unsigned long end_index;	/* The last page we want to read */
+	unsigned long cached = 0;	/* already there, and marked */
 	LIST_HEAD(page_pool);
 	int page_idx;
 	int ret = 0;
 	loff_t isize = i_size_read(inode);
 
+	if (prefetched)
+		*prefetched = 0;
+
 	if (isize == 0)
 		goto out;
 
@@ -170,6 +218,8 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 
 		rcu_read_lock();
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
+		if (page && PagePrefetched(page))
+			cached++;
 		rcu_read_unlock();
 		if (page)
 			continue;
@@ -178,6 +228,9 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (!page)
 			break;
 		page->index = page_offset;
+		if (prefetched && (page_offset < demand ||
+				   page_offset - demand >= demand_size))
+			__SetPagePrefetched(page);
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
@@ -192,6 +245,13 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	if (ret)
 		read_pages(mapping, filp, &page_pool, ret);
 	BUG_ON(!list_empty(&page_pool));
+
+	if (prefetched && ret) {
+		unsigned long now;
+
+		now = count_prefetched(mapping, offset, offset + page_idx);
+		*prefetched = now > cached ? now - cached : 0;
+	}
 out:
 	return ret;
 }
@@ -217,7 +277,8 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (this_chunk > nr_to_read)
 			this_chunk = nr_to_read;
 		err = __do_page_cache_readahead(mapping, filp,
-						offset, this_chunk, 0);
+						offset, this_chunk, 0, 0, 0,
+						NULL);
 		if (err < 0) {
 			ret = err;
 			break;
@@ -241,18 +302,56 @@ unsigned long max_sane_readahead(unsigned long nr)
 
 /*
  * Submit IO for the read-ahead request in file_ra_state.
+ *
+ * The pages of a window are only added to ra_issued when the next window
+ * is submitted, so that a window the reader hasn't got to yet doesn't
+ * count against it.  Only the pages that ended up in the page cache
+ * marked PG_prefetched are counted, those are the ones that can be hits.
+ * The @demand_size pages at @demand are being waited for by the reader and
+ * would have been read anyway, so they are neither marked nor counted.
+ * The counts are halved every so often to follow what the file is being
+ * used for now.
  */
 unsigned long ra_submit(struct file_ra_state *ra,
-		       struct address_space *mapping, struct file *filp)
+		       struct address_space *mapping, struct file *filp,
+		       pgoff_t demand, unsigned long demand_size)
 {
+	unsigned long prefetched;
 	int actual;
 
 	actual = __do_page_cache_readahead(mapping, filp,
-					ra->start, ra->size, ra->async_size);
+					ra->start, ra->size, ra->async_size,
+					demand, demand_size, &prefetched);
+
+	ra->ra_issued += ra->ra_last;
+	ra->ra_last = prefetched;
+	if (ra->ra_issued > RA_FEEDBACK_WINDOWS * ra->ra_pages) {
+		ra->ra_issued /= 2;
+		ra->ra_hits /= 2;
+	}
 
 	return actual;
 }
 
+/*
+ * The readahead window limit for @ra, scaled down by the share of the
+ * pages read ahead for the file that went unused.  Files read through
+ * keep the full window, while small random reads on flash, which are
+ * cheap anyway, stop pulling in pages nobody asks for.
+ */
+unsigned long ra_adaptive_max(struct file_ra_state *ra)
+{
+	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long hits = min_t(unsigned long, ra->ra_hits, ra->ra_issued);
+
+	/* Readahead disabled, or too few pages read ahead yet to tell */
+	if (!max || ra->ra_issued < max)
+		return max;
+
+	return max_t(unsigned long, max * hits / ra->ra_issued,
+		     min_t(unsigned long, max, RA_MIN_PAGES));
+}
+
 /*
  * Set the initial window size, round to next power of 2 and square
  * for small size, x 4 for medium, and x 2 for large
@@ -392,7 +491,7 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = ra_adaptive_max(ra);
 
 	/*
 	 * start of file
@@ -459,7 +558,8 @@ ondemand_readahead(struct address_space *mapping,
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
-	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0,
+					 0, 0, NULL);
 
 initial_readahead:
 	ra->start = offset;
@@ -477,7 +577,7 @@ readit:
 		ra->size += ra->async_size;
 	}
 
-	return ra_submit(ra, mapping, filp);
+	return ra_submit(ra, mapping, filp, offset, req_size);
 }
 
 /**
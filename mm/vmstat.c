@@ -855,6 +855,9 @@ static const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"readahead_hit",
+	"readahead_waste",
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",